@@ -67,17 +67,22 @@ private:
   static maudio_block_t *block_left;
   static maudio_block_t *block_right;
   static uint16_t block_offset;
+  static uint32_t block_seq; // block periods since begin (sequence number of blocks)
 
   void config_i2s(void);
+
+  friend class c_bench;
 };
 
 // for 32 bit I2S we need doubled buffer
-static uint32_t i2s_rx_buffer_32[2*AUDIO_BLOCK_SAMPLES_NCH];
+// on T4 in OCRAM (DMAMEM), aligned to cache lines for invalidation in isr32
+static uint32_t i2s_rx_buffer_32[2*AUDIO_BLOCK_SAMPLES_NCH] MEM_PLACE(I2S_MEM) __attribute__((aligned(32)));
 int16_t I2S_32::shift=8; //8 shifts 24 bit data to LSB
 
 maudio_block_t * I2S_32:: block_left = NULL;
 maudio_block_t * I2S_32:: block_right = NULL;
 uint16_t I2S_32:: block_offset = 0;
+uint32_t I2S_32:: block_seq = 0;
 bool I2S_32::update_responsibility = false;
 DMAChannel I2S_32::dma(false);
 
@@ -105,7 +110,7 @@ void I2S_32::begin(void)
   dma.TCD->DADDR = i2s_rx_buffer_32;
   dma.TCD->DOFF = 4;
   dma.TCD->CITER_ELINKNO = sizeof(i2s_rx_buffer_32) / 4;
-  dma.TCD->DLASTSGA = -sizeof(i2s_rx_buffer_32);
+  dma.TCD->DLASTSGA = -(int32_t)sizeof(i2s_rx_buffer_32);
   dma.TCD->BITER_ELINKNO = sizeof(i2s_rx_buffer_32) / 4;
   dma.TCD->CSR = DMA_TCD_CSR_INTHALF | DMA_TCD_CSR_INTMAJOR;
 
@@ -128,7 +133,8 @@ void I2S_32::begin(void)
 
 void I2S_32::isr32(void)
 {
-  uint32_t daddr, offset;
+  uintptr_t daddr;
+  uint32_t offset;
   const int32_t *src, *end;
 
 //  char * dest_left, *dest_right;
@@ -136,11 +142,11 @@ void I2S_32::isr32(void)
   data_t *dest_left, *dest_right; 
   maudio_block_t *left, *right;
 
-  daddr = (uint32_t)(dma.TCD->DADDR);
+  daddr = (uintptr_t)(dma.TCD->DADDR);
 
   dma.clearInterrupt();
   
-  if (daddr < (uint32_t)i2s_rx_buffer_32 + sizeof(i2s_rx_buffer_32) / 2) {
+  if (daddr < (uintptr_t)i2s_rx_buffer_32 + sizeof(i2s_rx_buffer_32) / 2) {
     // DMA is receiving to the first half of the buffer
     // need to remove data from the second half
     src = (int32_t *)&i2s_rx_buffer_32[AUDIO_BLOCK_SAMPLES_NCH];
@@ -152,6 +158,10 @@ void I2S_32::isr32(void)
     src = (int32_t *)&i2s_rx_buffer_32[0];
     end = (int32_t *)&i2s_rx_buffer_32[AUDIO_BLOCK_SAMPLES_NCH];
   }
+#if defined(__IMXRT1062__)
+  // DMA wrote to memory behind the D-cache: discard cached copy of this half
+  arm_dcache_delete((void *)src, sizeof(i2s_rx_buffer_32) / 2);
+#endif
   
    // extract 16/32 bit from 32 bit I2S buffer but shift to right first
    // there will be two buffers with each having "AUDIO_BLOCK_SAMPLES_NCH" samples
@@ -178,6 +188,8 @@ void I2S_32::update(void)
 {
   maudio_block_t *new_left=NULL, *new_right=NULL, *out_left=NULL, *out_right=NULL;
 
+  block_seq++;
+
   // allocate 2 new blocks, but if one fails, allocate neither
   new_left = allocate();
   if (new_left != NULL) {
@@ -200,6 +212,8 @@ void I2S_32::update(void)
     __enable_irq();
     
     // then transmit the DMA's former blocks
+    // periods without blocks (no memory) leave a gap in the sequence
+    out_left->seq = out_right->seq = block_seq;
     transmit(out_left, 0);
     release(out_left);
     transmit(out_right, 1);
@@ -310,6 +324,10 @@ void I2S_32::update(void)
           | I2S_RCR4_FSE | I2S_RCR4_FSP | I2S_RCR4_FSD;
     I2S1_RCR5 = I2S_RCR5_WNW((32-1)) | I2S_RCR5_W0W((32-1)) | I2S_RCR5_FBT((32-1));
   }
+
+#elif defined(HOST_BUILD)
+  // I2S is simulated by host DMA (host/hal_host.cpp)
+  void I2S_32::config_i2s(void) { }
 #endif
 
 #endif
@@ -0,0 +1,231 @@
+/* SGTL5000 Recorder for Teensy
+ * Copyright (c) 2018, Walter Zimmer
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice, development funding notice, and this permission
+ * notice shall be included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+/*
+ * micro-benchmark of the acquisition pipeline (DO_BENCH>0)
+ *
+ * times each stage a block passes, with the DMA interrupt disabled:
+ *   isr32            (both halves of the I2S buffer)
+ *   I2S_32::update   (allocate and transmit)
+ *   queue update     (all NCH queues)
+ *   multiplex        (readBuffer, multiplex into disk buffer, freeBuffer)
+ *   uSD write        (write + flush of full disk buffers, incl. card, per block)
+ * and prints cycles and ns per block, followed by a capacity table for all fsamps
+ *
+ * cycles are counted with DWT->CYCCNT on target and with the TSC (x86) or
+ * the monotonic clock on host
+ *
+ * the file written during benchmark is deleted afterwards
+ */
+#ifndef _BENCH_H
+#define _BENCH_H
+
+#include "core_pins.h"
+#include "usb_serial.h"
+#include "config.h"
+
+#ifndef BENCH_BLOCKS
+  #define BENCH_BLOCKS 2000 // number of audio blocks per benchmark
+#endif
+
+#if defined(HOST_BUILD)
+  #include <time.h>
+  #if defined(__x86_64__) || defined(__i386__)
+    #include <x86intrin.h>
+    static inline uint32_t benchTicks(void) { return (uint32_t) __rdtsc(); }
+  #else
+    static inline uint32_t benchTicks(void)
+    { struct timespec ts; clock_gettime(CLOCK_MONOTONIC, &ts); return ts.tv_sec*1000000000u + ts.tv_nsec; }
+  #endif
+
+  static uint32_t benchTickRate = 0;
+  static void benchInit(void)
+  { // calibrate tick rate against monotonic clock
+    struct timespec t0, t1;
+    clock_gettime(CLOCK_MONOTONIC, &t0);
+    uint32_t c0 = benchTicks();
+    delay(50);
+    uint32_t c1 = benchTicks();
+    clock_gettime(CLOCK_MONOTONIC, &t1);
+    double dt = (t1.tv_sec-t0.tv_sec) + 1e-9*(t1.tv_nsec-t0.tv_nsec);
+    benchTickRate = (uint32_t) ((c1-c0)/dt);
+  }
+#else
+  static inline uint32_t benchTicks(void) { return ARM_DWT_CYCCNT; }
+
+  static uint32_t benchTickRate = 0;
+  static void benchInit(void)
+  { ARM_DEMCR |= ARM_DEMCR_TRCENA;
+    ARM_DWT_CTRL |= ARM_DWT_CTRL_CYCCNTENA;
+    #if defined(__IMXRT1062__)
+      benchTickRate = F_CPU_ACTUAL;
+    #else
+      benchTickRate = F_CPU;
+    #endif
+  }
+#endif
+
+typedef struct
+{ const char *name;
+  uint64_t sum;   // ticks
+  uint32_t max;   // ticks
+  uint32_t num;   // calls
+} benchStat_t;
+
+static inline void benchAdd(benchStat_t *st, uint32_t ticks)
+{ st->sum += ticks; st->num++;
+  if(ticks > st->max) st->max = ticks;
+}
+
+static inline float benchNs(uint64_t ticks) { return (float) (1e9 * (double) ticks / (double) benchTickRate); }
+
+// average cost per audio block (nblocks) of a stage
+static void benchPrint(benchStat_t *st, uint32_t nblocks)
+{ uint64_t cyc = st->sum/nblocks;
+  Serial.printf("  %-16s %10lu %10.0f %10.0f\n", st->name,
+    (unsigned long) cyc, benchNs(cyc), benchNs(st->max));
+}
+
+class c_bench
+{
+  public:
+    // pipeline stages, as configured (NCH, NBYTE, AUDIO_BLOCK_SAMPLES_NCH)
+    static void pipeline(uint32_t nblocks)
+    { benchStat_t isr  = {"isr32", 0, 0, 0};
+      benchStat_t upd  = {"I2S_32::update", 0, 0, 0};
+      benchStat_t que  = {"queue update", 0, 0, 0};
+      benchStat_t mux  = {"multiplex", 0, 0, 0};
+      benchStat_t wrt  = {"uSD write", 0, 0, 0};
+      uint32_t t0;
+
+      // keep DMA and software interrupt out of the measurement
+      I2S_32::dma.disable();
+      NVIC_DISABLE_IRQ(IRQ_SOFTWARE);
+
+      for(uint32_t ii=0; ii<2*AUDIO_BLOCK_SAMPLES_NCH; ii++) i2s_rx_buffer_32[ii] = (ii*0x12345) << 8;
+      for(int ii=0; ii<NCH; ii++) queue[ii].begin();
+
+      // card was mounted and tested by setup()
+      outptr = diskBuffer;
+
+      acq.update(); // hand first blocks to isr
+      for(uint32_t nb=0; nb<nblocks; nb++)
+      {
+        // DMA in first half: isr reads second half and vice versa
+        I2S_32::dma.TCD->DADDR = &i2s_rx_buffer_32[AUDIO_BLOCK_SAMPLES_NCH];
+        t0=benchTicks(); I2S_32::isr32(); benchAdd(&isr, benchTicks()-t0);
+        I2S_32::dma.TCD->DADDR = &i2s_rx_buffer_32[0];
+        t0=benchTicks(); I2S_32::isr32(); benchAdd(&isr, benchTicks()-t0);
+
+        t0=benchTicks(); acq.update(); benchAdd(&upd, benchTicks()-t0);
+
+        t0=benchTicks();
+        for(int ii=0; ii<NCH; ii++) queue[ii].update();
+        benchAdd(&que, benchTicks()-t0);
+
+        if(outptr+NCH*AUDIO_BLOCK_SAMPLES_NCH > diskBuffer+BUFFERSIZE)
+        { t0=benchTicks();
+          uSD.write(diskBuffer, outptr-diskBuffer, 0);
+          diskBuffer = uSD.nextBuffer();
+          uSD.flush();
+          benchAdd(&wrt, benchTicks()-t0);
+          outptr = diskBuffer;
+        }
+
+        t0=benchTicks();
+        data_t *data[NCH];
+        for(int ii=0; ii<NCH; ii++) data[ii] = (data_t *)queue[ii].readBuffer();
+        if(data[NCH-1]) outptr = multiplex<NCH,data_t>(outptr, data, 0, AUDIO_BLOCK_SAMPLES_NCH);
+        for(int ii=0; ii<NCH; ii++) queue[ii].freeBuffer();
+        benchAdd(&mux, benchTicks()-t0);
+      }
+
+      uSD.discard();
+      uSD.nCount = uSD.nBusy = uSD.nPendMax = 0;
+      outptr = diskBuffer;
+      for(int ii=0; ii<NCH; ii++) { queue[ii].end(); queue[ii].clear(); }
+
+      NVIC_CLEAR_PENDING(IRQ_SOFTWARE);
+      NVIC_ENABLE_IRQ(IRQ_SOFTWARE);
+      I2S_32::dma.enable();
+
+      Serial.printf("\nBenchmark: NCH %d, NBYTE %d, %d samples/block/channel, %lu blocks, %lu Hz ticks\n",
+        NCH, NBYTE, AUDIO_BLOCK_SAMPLES_NCH, (unsigned long) nblocks, (unsigned long) benchTickRate);
+      Serial.printf("  %-16s %10s %10s %10s\n", "stage", "cyc/block", "ns/block", "max ns");
+      benchPrint(&isr, nblocks);
+      benchPrint(&upd, nblocks);
+      benchPrint(&que, nblocks);
+      benchPrint(&mux, nblocks);
+      benchPrint(&wrt, nblocks);
+
+      // capacity: cost of one block against block period
+      float cpu = benchNs((isr.sum + upd.sum + que.sum + mux.sum)/nblocks);
+      float tot = cpu + benchNs(wrt.sum/nblocks);
+      Serial.printf("\n  %8s %10s %8s %8s\n", "fsamp", "block us", "cpu %", "total %");
+      for(uint32_t ii=0; ii<sizeof(fsamps)/sizeof(fsamps[0]); ii++)
+      { float tblk = 1e9f*AUDIO_BLOCK_SAMPLES_NCH/fsamps[ii];
+        Serial.printf("  %8d %10.1f %8.2f %8.2f %s\n", fsamps[ii], tblk/1000.0f,
+          100.0f*cpu/tblk, 100.0f*tot/tblk, (tot<tblk)? "": "overrun");
+      }
+      Serial.printf("  max sustained fsamp: %.0f Hz (cpu only: %.0f Hz)\n",
+        1e9f*AUDIO_BLOCK_SAMPLES_NCH/tot, 1e9f*AUDIO_BLOCK_SAMPLES_NCH/cpu);
+    }
+
+    // multiplex for different number of channels (AUDIO_BLOCK_SAMPLES frames)
+    // input changes per block and a checksum of the output is printed, so the loop is not optimized away
+    template <int nch>
+    static void mux(uint32_t nblocks)
+    { static data_t src[8][AUDIO_BLOCK_SAMPLES];
+      data_t *ptr[nch];
+      for(int ii=0; ii<nch; ii++) ptr[ii] = src[ii];
+      for(int ii=0; ii<nch; ii++) for(int jj=0; jj<AUDIO_BLOCK_SAMPLES; jj++) src[ii][jj] = (data_t) (ii+jj);
+      data_t *out = diskBuffers[0];
+      uint32_t check = 0;
+
+      benchStat_t st = {"multiplex", 0, 0, 0};
+      for(uint32_t nb=0; nb<nblocks; nb++)
+      { src[nb % nch][nb % AUDIO_BLOCK_SAMPLES] = (data_t) nb;
+        uint32_t t0=benchTicks();
+        multiplex<nch,data_t>(out, ptr, 0, AUDIO_BLOCK_SAMPLES);
+        benchAdd(&st, benchTicks()-t0);
+        check = 31*check + (uint32_t) out[(nb % AUDIO_BLOCK_SAMPLES)*nch + nb % nch];
+      }
+      uint64_t cyc = st.sum/nblocks;
+      Serial.printf("  %4d %10lu %10.0f %8.2f %08lx\n", nch, (unsigned long) cyc, benchNs(cyc),
+        benchNs(cyc)/AUDIO_BLOCK_SAMPLES, (unsigned long) check);
+    }
+};
+
+static void benchRun(void)
+{ benchInit();
+  c_bench::pipeline(BENCH_BLOCKS);
+
+  static_assert(8*AUDIO_BLOCK_SAMPLES <= BUFFERSIZE, "disk buffer too small for multiplex benchmark");
+  Serial.printf("\n  %4s %10s %10s %8s %8s\n", "nch", "cyc/block", "ns/block", "ns/frame", "check");
+  c_bench::mux<1>(BENCH_BLOCKS);
+  c_bench::mux<2>(BENCH_BLOCKS);
+  c_bench::mux<4>(BENCH_BLOCKS);
+  c_bench::mux<8>(BENCH_BLOCKS);
+  Serial.println();
+}
+
+#endif
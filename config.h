@@ -30,48 +30,232 @@ uint32_t fsamps[] = {8000, 16000, 32000, 44100, 48000, 96000, 192000, 384000};
  */
 
 #define DO_DEBUG 1
-#define FSI 4   // desired sampling frequency index into fsamps
-#define NCH 1
-#define NBYTE 2 // data word size
+#ifndef DO_BENCH
+  #define DO_BENCH 0 // 1: benchmark acquisition pipeline at startup (see bench.h)
+#endif
+#ifndef FSI
+  #define FSI 4   // desired sampling frequency index into fsamps
+#endif
+#ifndef NCH
+  #define NCH 1
+#endif
+#ifndef NBYTE
+  #define NBYTE 2 // data word size
+#endif
 
 #define PJRC 0  // use core audio SW
 #define WMXZ 1  // use WMXZ audio SW
 #define AUDIO_MODE WMXZ
 
+#ifndef USE_GOVERNOR
+  #define USE_GOVERNOR 1 // T4: CPU clock from measured load (governor.h), 0: fixed 24 MHz
+#endif
+
+#ifndef USE_WFI
+  #define USE_WFI 1 // loop() sleeps (wfi) until LOOP_BATCH blocks are queued, a deadline or serial input
+#endif
+#ifndef LOOP_BATCH
+  #define LOOP_BATCH 4 // audio blocks per wake-up of loop()
+#endif
+
 #define USE_SDIO 0
+#define SD_CHECK 1 // time uSD writes at startup to choose write size (see c_uSD::characterize)
+// file system backend (default: FS_SDFAT on Teensy, FS_POSIX on host)
+//#define FS_BACKEND FS_SIM // simulate uSD writes (no card needed, data are discarded)
 
 //#define AUDIO_SELECT AUDIO_INPUT_LINEIN 
 #define AUDIO_SELECT AUDIO_INPUT_MIC
 #define MicGain 0 // (0 - 64) dB
 #define SEL_LR 0  // record only a single channel (0 left, 1 right)
 
-#if defined(__MK20DX256__)
-  #define MQUEU (100/NCH) // number of buffers in aquisition queue
+#ifndef USE_SIZING
+  #define USE_SIZING 0 // 1: take MQUEU, NPOOL and BUFFERSIZE from sizing.h (generated by 'make -C host sizing')
+#endif
+
+#if USE_SIZING>0
+  #include "sizing.h" // sizes for this NCH/NBYTE
+  #define MQUEU sizingMQUEU[FSI] // number of buffers in aquisition queue
+  #define NPOOL sizingNPOOL[FSI] // queues of all channels
+  #define BUFFERSIZE sizingBUFFERSIZE[FSI]
+  static_assert(sizingMQUEU[FSI] > 0, "sizing.h: uSD card does not keep up at this FSI");
+#elif defined(__MK20DX256__)
+  #define MQUEU (70*2/(NCH*NBYTE)) // number of buffers in aquisition queue
 #elif defined(__MK64FX512__)
-  #define MQUEU (200/NCH) // number of buffers in aquisition queue
+  #define MQUEU (200*2/(NCH*NBYTE)) // number of buffers in aquisition queue
 #elif defined(__MK66FX1M0__)
-  #define MQUEU (600/NCH) // number of buffers in aquisition queue
+  #define MQUEU (600*2/(NCH*NBYTE)) // number of buffers in aquisition queue
 #elif defined(__IMXRT1062__)
-  #define MQUEU (900/NCH) // number of buffers in aquisition queue
+  #define MQUEU (900*2/(NCH*NBYTE)) // number of buffers in aquisition queue
 #else
   #define MQUEU 53 // number of buffers in aquisition queue
 #endif
   
 
-// definitions for logging
-#define BUFFERSIZE (8*1024)
+// definitions for logging (disk buffers of BUFFERSIZE samples, must fit the memory budget below)
+#if defined(__MK20DX256__)
+  #ifndef BUFFERSIZE
+    #define BUFFERSIZE (4*1024*2/NBYTE)
+  #endif
+  #ifndef NDBUF
+    #define NDBUF 2 // number of disk buffers (one filled while other is written)
+  #endif
+  #ifndef IDX_MAX
+    #define IDX_MAX 64 // index entries per file, spacing is doubled when full
+  #endif
+#elif defined(__MK64FX512__) || defined(__MK66FX1M0__)
+  #ifndef BUFFERSIZE
+    #define BUFFERSIZE (8*1024*2/NBYTE)
+  #endif
+#endif
+#ifndef BUFFERSIZE
+  #define BUFFERSIZE (8*1024)
+#endif
+#ifndef NDBUF
+  #define NDBUF 3 // number of disk buffers (one filled while others are written)
+#endif
+#ifndef NPOOL
+  #define NPOOL (MQUEU+6) // blocks in audio memory pool, shared by all queues, I2S and loop()
+#endif
+#ifndef IDX_EVERY
+  #define IDX_EVERY 1 // seek index entry (.idx sidecar) every IDX_EVERY disk buffers (0: no index)
+#endif
+#ifndef IDX_MAX
+  #define IDX_MAX 128 // index entries per file, spacing is doubled when full
+#endif
+
+// file format: raw samples behind 512 byte header (.bin), or WAV/RF64 (.wav, wav_fmt.h)
+// WAV files have a 1024 byte header (recorder header as chunk 'wmxz'), sizes are patched at close
+#define OUT_BIN 0
+#define OUT_WAV 1
+#ifndef OUT_FORMAT
+  #define OUT_FORMAT OUT_BIN
+#endif
+#define FILE_HDR_BYTES ((OUT_FORMAT==OUT_WAV)? 1024: 512) // first sample (sector aligned)
+#define FILE_EXT ((OUT_FORMAT==OUT_WAV)? "wav": "bin")
+
+#ifndef MARK_DROPS
+  // WAV data must be samples only: drops show as jumps between index entries (sample vs usec)
+  #define MARK_DROPS (OUT_FORMAT==OUT_BIN) // write drop marker (marker_fmt.h) into data where blocks were lost
+#endif
 
 // times for acquisition and filing
 uint32_t a_on = 60; // acquisition on time
 uint32_t a_off =0; // acquisition off time
 uint32_t t_on = 20; // file on time
 
-uint16_t r_h1s =  8;   // start of record period 1
-uint16_t r_h1e = 12;   // end of record period 1 (if smaller than r_h1s then runs over midnight)
-uint16_t r_h2s = 12;   // start of record period 2
-uint16_t r_h2e = 22;   // end of record period 2 (if smaller than r_h2s then runs over midnight)
+// daily record periods (hours) {start, end}, at most SCHED_MAX_PERIODS (schedule.h)
+// end smaller than start runs over midnight, {0, 24}: whole day, no period: whole day
+uint16_t r_hours[][2] = {{8, 12}, {12, 22}};
+#define R_NPER (sizeof(r_hours)/sizeof(r_hours[0]))
 
 #define DirPrefix "DIR"
 #define FilePrefix "WMXZ"
 
+/*
+ * memory placement and budget
+ * RAM of all acquisition buffers per memory region, checked at compile time
+ * Teensy 3.x: all in one RAM (counted as DTCM)
+ * T4 (approximate bandwidth at 600 MHz):
+ *   DTCM   (RAM1) 64 bit tightly coupled, single cycle at core clock (~4.8 GB/s), not cached,
+ *          shared with code in ITCM: audio block pool, queues and ISR state
+ *   OCRAM  (RAM2, DMAMEM) on AXI bus at 1/4 core clock (~1.2 GB/s), cached in 32 kB L1 D-cache:
+ *          DMA buffers (invalidated before the CPU reads, flushed before DMA reads) and disk buffers
+ *   EXTMEM (T4.1 PSRAM) QSPI at 88 MHz (~40 MB/s), cached: only for very large disk buffers
+ * sizes are the parts of a region available to these buffers
+ */
+#ifndef AUDIO_BLOCK_SAMPLES
+  #define AUDIO_BLOCK_SAMPLES 128 // samples per audio block and channel (multiplied by NCH)
+#endif
+
+#define MEM_DTCM   0
+#define MEM_OCRAM  1
+#define MEM_EXTMEM 2
+
+#if defined(__IMXRT1062__)
+  #ifndef MEM_SIZE_DTCM
+    #define MEM_SIZE_DTCM (384*1024) // 512 kB minus ITCM (code) and stack
+  #endif
+  #ifndef MEM_SIZE_OCRAM
+    #define MEM_SIZE_OCRAM (448*1024) // 512 kB minus USB and other DMAMEM buffers
+  #endif
+  #ifndef MEM_SIZE_EXTMEM
+    #define MEM_SIZE_EXTMEM 0 // set to (8*1024*1024) if PSRAM is soldered to T4.1
+  #endif
+#elif defined(__MK66FX1M0__)
+  #define MEM_SIZE_DTCM (224*1024) // 256 kB minus stack and other variables
+  #define MEM_SIZE_OCRAM 0
+  #define MEM_SIZE_EXTMEM 0
+#elif defined(__MK64FX512__)
+  #define MEM_SIZE_DTCM (160*1024)
+  #define MEM_SIZE_OCRAM 0
+  #define MEM_SIZE_EXTMEM 0
+#elif defined(__MK20DX256__)
+  #define MEM_SIZE_DTCM (48*1024)
+  #define MEM_SIZE_OCRAM 0
+  #define MEM_SIZE_EXTMEM 0
+#else
+  #define MEM_SIZE_DTCM (64*1024*1024)
+  #define MEM_SIZE_OCRAM 0
+  #define MEM_SIZE_EXTMEM 0
+#endif
+
+// region of each buffer
+#ifndef POOL_MEM
+  #define POOL_MEM MEM_DTCM // audio blocks (mAudioMemory)
+#endif
+#if defined(__IMXRT1062__)
+  #ifndef DBUF_MEM
+    #define DBUF_MEM MEM_OCRAM // disk buffers (logger_if.h)
+  #endif
+  #ifndef I2S_MEM
+    #define I2S_MEM MEM_OCRAM  // I2S DMA buffer (I2S_32.h)
+  #endif
+#else
+  #ifndef DBUF_MEM
+    #define DBUF_MEM MEM_DTCM
+  #endif
+  #ifndef I2S_MEM
+    #define I2S_MEM MEM_DTCM
+  #endif
+#endif
+
+// placement attribute for region, e.g. MEM_PLACE(DBUF_MEM)
+#define MEM_PLACE(region) MEM_PLACE_(region)
+#define MEM_PLACE_(region) MEM_PLACE_##region
+#define MEM_PLACE_0
+#if defined(__IMXRT1062__)
+  #define MEM_PLACE_1 DMAMEM
+  #define MEM_PLACE_2 EXTMEM
+#else
+  #define MEM_PLACE_1
+  #define MEM_PLACE_2
+#endif
+
+// memory budget of these regions: mem_budget.h
+
+static_assert(BUFFERSIZE % NCH == 0, "BUFFERSIZE must be multiple of NCH");
+static_assert(!(MARK_DROPS>0 && OUT_FORMAT==OUT_WAV), "drop markers are not allowed in WAV data");
+#if MARK_DROPS>0
+  // drop markers (32 bytes) must always fit in remaining disk buffer and keep frames aligned
+  static_assert((BUFFERSIZE*NBYTE) % 32 == 0 && (AUDIO_BLOCK_SAMPLES*NCH*NBYTE) % 32 == 0,
+    "drop markers need disk buffer and audio blocks in multiples of 32 bytes");
+  static_assert(32 % (NCH*NBYTE) == 0, "drop marker (32 bytes) must be a whole number of frames");
+#endif
+
+// blocks per channel that can wait for disk: limited by queue and by shared pool
+constexpr uint32_t queueBlocks(void)
+{ return ((MQUEU-1) < (NPOOL-6)/NCH)? (MQUEU-1): (NPOOL-6)/NCH;
+}
+
+// blocks loop() waits for before draining the queue: LOOP_BATCH, but at most a quarter of the
+// queue (small sized queues, USE_SIZING) and at least one block
+constexpr uint32_t loopBatch(void)
+{ return (queueBlocks()/4 < 1)? 1: (LOOP_BATCH < queueBlocks()/4)? LOOP_BATCH: queueBlocks()/4;
+}
+static_assert(LOOP_BATCH>=1, "LOOP_BATCH must be at least one block");
+
+// achievable buffering (ms) at sampling frequency fs: queue and disk buffers not being written
+constexpr uint32_t bufferingQueue(uint32_t fs) { return (uint64_t) queueBlocks()*AUDIO_BLOCK_SAMPLES*NCH*1000/fs; }
+constexpr uint32_t bufferingDisk(uint32_t fs) { return (uint64_t) (NDBUF-1)*(BUFFERSIZE/NCH)*1000/fs; }
+
 #endif
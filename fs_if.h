@@ -0,0 +1,191 @@
+/* SGTL5000 Recorder for Teensy
+ * Copyright (c) 2018, Walter Zimmer
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice, development funding notice, and this permission
+ * notice shall be included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#ifndef _FS_IF_H
+#define _FS_IF_H
+
+#include "core_pins.h"
+
+#define FS_SDFAT 0 // uSD card with SdFat
+#define FS_SIM   1 // no storage, only write latency is simulated
+#define FS_POSIX 2 // host directory (Linux)
+
+/*
+ * file system interface used by c_uSD (logger_if.h)
+ * one file is written (current), a second one may be opened ahead of time
+ * (prepare) and becomes current with rotate(); the retired file is closed
+ * later by idle()
+ */
+class c_FS
+{
+  public:
+    virtual void init(void) = 0;
+    virtual void exit(void) = 0;
+
+    virtual void mkDir(char * dirname) = 0;
+    virtual void chDir(char * dirname) = 0;
+    // remove directory if it is empty, returns 1 if removed
+    virtual int rmDir(char * dirname) = 0;
+    // CID register of card (16 bytes, as sent by card), returns 0 if not available
+    virtual int readCID(uint8_t *cid) = 0;
+
+    // nbytes > 0: preallocate file
+    virtual void open(char * filename, uint64_t nbytes) = 0;
+    // length: valid bytes (file is truncated)
+    virtual void close(uint64_t length) = 0;
+    // delete current file (not used)
+    virtual void remove(void) = 0;
+
+    virtual void prepare(char * filename, uint64_t nbytes) = 0;
+    virtual int isReady(void) = 0;
+    virtual void rotate(uint64_t length) = 0;
+    virtual int idle(int discard=0) = 0;
+
+    // card is still programming previous data, a write now would block
+    virtual int isBusy(void) = 0;
+    virtual uint32_t write(void *buffer, uint32_t nbuf) = 0;
+    virtual uint32_t read(void *buffer, uint32_t nbuf) = 0;
+
+    // write small file in one go (e.g. index sidecar), independent of current file
+    virtual void save(char * filename, void *buffer, uint32_t nbytes) = 0;
+};
+
+#ifndef SIM_WRITE_LATENCY
+  #define SIM_WRITE_LATENCY 2000 // us card is busy after each write
+#endif
+#ifndef SIM_WRITE_RATE
+  #define SIM_WRITE_RATE 20 // bytes per us (20 MB/s)
+#endif
+#ifndef SIM_STALL_PROB
+  #define SIM_STALL_PROB 0 // probability of a stall per write (in units of 1/65536)
+#endif
+#ifndef SIM_STALL_TIME
+  #define SIM_STALL_TIME 250000 // us duration of a stall (e.g. card garbage collection)
+#endif
+
+/*
+ * model of uSD write latency
+ * after each write the card is busy for
+ *   base + nbytes/rate
+ * and, with probability stallProb/65536, for additional stallTime
+ * alternatively, busy times are replayed from a recorded trace (us per write)
+ */
+class c_latency
+{
+  public:
+    uint32_t base=SIM_WRITE_LATENCY;    // us per write
+    uint32_t rate=SIM_WRITE_RATE;       // bytes per us
+    uint32_t stallProb=SIM_STALL_PROB;  // per write, 1/65536
+    uint32_t stallTime=SIM_STALL_TIME;  // us
+
+    uint32_t nStall=0;    // number of stalls
+    uint32_t maxBusy=0;   // longest busy time (us)
+
+    void setTrace(const uint32_t *tr, uint32_t n) { trace=tr; ntrace=n; itrace=0; }
+    void reset(void) { seed=0x12345678; itrace=0; nStall=0; maxBusy=0; }
+
+    // busy time (us) of next write of nbytes
+    uint32_t busyTime(uint32_t nbytes)
+    { uint32_t tb;
+      if(ntrace)
+      { tb = trace[itrace++];
+        if(itrace==ntrace) itrace=0;
+      }
+      else
+      { tb = base + nbytes/rate;
+        if(stallProb && (rnd() & 0xffff) < stallProb) { tb += stallTime; nStall++; }
+      }
+      if(tb>maxBusy) maxBusy=tb;
+      return tb;
+    }
+
+    void start(uint32_t nbytes)
+    {
+      tbusy = busyTime(nbytes);
+      t0 = micros();
+    }
+
+    int isBusy(void) { return (micros()-t0) < tbusy; }
+    void wait(void) { while(isBusy()) ; }
+
+  private:
+    uint32_t t0=0;
+    uint32_t tbusy=0;
+    uint32_t seed=0x12345678;
+
+    const uint32_t *trace=0;
+    uint32_t ntrace=0;
+    uint32_t itrace=0;
+
+    uint32_t rnd(void) // xorshift32, reproducible
+    { seed ^= seed << 13; seed ^= seed >> 17; seed ^= seed << 5;
+      return seed;
+    }
+};
+
+/*
+ * simulated file system
+ * data are discarded, but after each write the card reports busy
+ * as given by the latency model
+ * allows to measure the overlap of acquisition and disk writes without uSD card
+ */
+class c_simFS : public c_FS
+{
+  private:
+  uint64_t nbytes=0;
+  int16_t ready=0;
+
+  public:
+    c_latency lat;
+
+    void init(void) { Serial.println("Using simulated uSD"); }
+    void exit(void) { }
+
+    void mkDir(char * dirname)  { }
+    void chDir(char * dirname)  { }
+    int rmDir(char * dirname)   { return 0; }
+    int readCID(uint8_t *cid)   { return 0; }
+
+    void open(char * filename, uint64_t nalloc) { nbytes=0; }
+    void close(uint64_t length) { lat.wait(); }
+    void remove(void) { }
+
+    void prepare(char * filename, uint64_t nalloc) { ready=1; }
+    int isReady(void) { return ready; }
+    void rotate(uint64_t length) { close(length); nbytes=0; ready=0; }
+    int idle(int discard=0) { if(ready && discard) { ready=0; return 1;} return 0; }
+
+    int isBusy(void) { return lat.isBusy(); }
+
+    uint32_t write(void *buffer, uint32_t nbuf)
+    {
+      lat.wait(); // as real card: block until previous write is done
+      nbytes += nbuf;
+      lat.start(nbuf);
+      return nbuf;
+    }
+
+    uint32_t read(void *buffer, uint32_t nbuf) { return 0; }
+    void save(char * filename, void *buffer, uint32_t nbytes) { lat.wait(); lat.start(nbytes); }
+};
+
+#endif
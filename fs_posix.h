@@ -0,0 +1,186 @@
+/* SGTL5000 Recorder for Teensy
+ * Copyright (c) 2018, Walter Zimmer
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice, development funding notice, and this permission
+ * notice shall be included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+// file system backend for host (Linux) builds
+// files are written below a host directory, the card timing is taken from
+// the latency model (fs_if.h), so that field problems can be reproduced
+
+#ifndef _FS_POSIX_H
+#define _FS_POSIX_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+#include "fs_if.h"
+
+#ifndef POSIX_ROOT
+  #define POSIX_ROOT "./sdcard" // host directory that replaces the uSD card
+#endif
+
+class c_posixFS : public c_FS
+{
+  private:
+  char root[128];
+  char cwd[128];
+  int fd[2]={-1,-1};
+  char name[2][256];
+  uint16_t cur=0;
+  int16_t ready=0;
+  int16_t old=0;
+  uint64_t oldLength=0;
+
+  void halt(const char *msg, const char *arg)
+  { fprintf(stderr,"%s %s: %s\n", msg, arg, strerror(errno));
+    ::exit(1);
+  }
+
+  // host path of file or directory
+  void hostPath(char *path, const char *filename)
+  { if(filename[0]=='/')
+      snprintf(path, 256, "%s%s", root, filename);
+    else
+      snprintf(path, 256, "%s%s/%s", root, cwd, filename);
+  }
+
+  void openFile(int ii, char * filename, uint64_t nbytes)
+  {
+    hostPath(name[ii], filename);
+    fd[ii] = ::open(name[ii], O_RDWR | O_CREAT | O_TRUNC, 0644);
+    if(fd[ii]<0) halt("file.open failed", name[ii]);
+    if(nbytes && posix_fallocate(fd[ii], 0, nbytes)) halt("preallocate failed", name[ii]);
+    lat.start(0); // directory and FAT update
+  }
+
+  void closeFile(int ii, uint64_t length)
+  {
+    if(fd[ii]<0) return;
+    #if OUT_FORMAT==OUT_WAV
+      // WAV sizes are known only now
+      uint8_t hdr[FILE_HDR_BYTES];
+      if(pread(fd[ii], hdr, FILE_HDR_BYTES, 0)==FILE_HDR_BYTES && wavPatch(hdr, FILE_HDR_BYTES, length))
+        if(pwrite(fd[ii], hdr, FILE_HDR_BYTES, 0)!=FILE_HDR_BYTES) halt("header patch failed", name[ii]);
+    #endif
+    if(ftruncate(fd[ii], length)) halt("truncate failed", name[ii]);
+    ::close(fd[ii]);
+    fd[ii]=-1;
+  }
+
+  public:
+    c_latency lat;
+
+    c_posixFS(void) { setRoot(POSIX_ROOT); }
+    void setRoot(const char *dir) { snprintf(root, sizeof(root), "%s", dir); cwd[0]=0; }
+
+    void init(void)
+    { Serial.print("Using host directory "); Serial.println(root);
+      ::mkdir(root, 0755);
+    }
+
+    void exit(void) { }
+
+    void mkDir(char * dirname)
+    { char path[256];
+      hostPath(path, dirname);
+      // create all parents
+      for(char *cp=path+strlen(root)+1; *cp; cp++)
+      { if(*cp=='/') { *cp=0; ::mkdir(path, 0755); *cp='/'; }
+      }
+      ::mkdir(path, 0755);
+    }
+
+    int rmDir(char * dirname)
+    { char path[256];
+      hostPath(path, dirname);
+      return ::rmdir(path)==0;
+    }
+
+    // stub: product name "POSIX", serial number from inode of root directory
+    int readCID(uint8_t *cid)
+    { struct stat st;
+      if(stat(root, &st)) return 0;
+      uint32_t sn = (uint32_t) st.st_ino;
+      const uint8_t reg[16] = {0, 'H', 'B', 'P', 'O', 'S', 'I', 'X', 0x10,
+        (uint8_t) (sn>>24), (uint8_t) (sn>>16), (uint8_t) (sn>>8), (uint8_t) sn, 0, 0, 1};
+      memcpy(cid, reg, 16);
+      return 1;
+    }
+
+    void chDir(char * dirname)
+    { if(dirname[0]=='/') snprintf(cwd, sizeof(cwd), "%s", dirname);
+      else { int nn=strlen(cwd); snprintf(cwd+nn, sizeof(cwd)-nn, "/%s", dirname); }
+    }
+
+    void open(char * filename, uint64_t nbytes) { openFile(cur, filename, nbytes); }
+    void close(uint64_t length) { lat.wait(); closeFile(cur, length); }
+    void remove(void) { ::close(fd[cur]); fd[cur]=-1; unlink(name[cur]); }
+
+    void prepare(char * filename, uint64_t nbytes)
+    { if(ready || old) return;
+      openFile(1-cur, filename, nbytes);
+      ready=1;
+    }
+    int isReady(void) { return ready; }
+    void rotate(uint64_t length) { cur=1-cur; ready=0; old=1; oldLength=length; }
+    int idle(int discard=0)
+    { if(old) { closeFile(1-cur, oldLength); old=0; return 1;}
+      if(ready && discard) { ::close(fd[1-cur]); fd[1-cur]=-1; unlink(name[1-cur]); ready=0; return 1;}
+      return 0;
+    }
+
+    int isBusy(void) { return lat.isBusy(); }
+
+    uint32_t write(void *buffer, uint32_t nbuf)
+    {
+      lat.wait(); // as real card: block until previous write is done
+      uint32_t nn=0;
+      while(nn<nbuf)
+      { ssize_t ret = ::write(fd[cur], (char *) buffer+nn, nbuf-nn);
+        if(ret<=0) halt("write failed", name[cur]);
+        nn += ret;
+      }
+      lat.start(nbuf);
+      return nbuf;
+    }
+
+    uint32_t read(void *buffer, uint32_t nbuf)
+    { ssize_t ret = ::read(fd[cur], buffer, nbuf);
+      return ret<0? 0: ret;
+    }
+
+    void save(char * filename, void *buffer, uint32_t nbytes)
+    { char path[256];
+      hostPath(path, filename);
+      lat.wait();
+      int fs = ::open(path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+      if(fs<0) halt("file.open failed", path);
+      if(::write(fs, buffer, nbytes) != (ssize_t) nbytes) halt("write failed", path);
+      ::close(fs);
+      lat.start(nbytes);
+    }
+};
+
+#endif
@@ -0,0 +1,130 @@
+/* SGTL5000 Recorder for Teensy
+ * Copyright (c) 2018, Walter Zimmer
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice, development funding notice, and this permission
+ * notice shall be included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+/*
+ * CPU clock governor
+ *
+ * loop() reports the time it was busy (audio blocks, disk service, file preparation);
+ * every GOV_WINDOW ms the busy time is converted into cycles and the lowest clock of
+ * govClocks[] is chosen that keeps the load below GOV_LOAD percent. A higher clock
+ * is set at once, a lower one only after GOV_HOLD windows agree.
+ * boost() runs at the highest clock while the audio queue backs up or files are flushed.
+ *
+ * T4: set_arm_clock() (also lowers core voltage). I2S (PLL4, i2s_mods.h), uSD and USB
+ *     clocks do not depend on the ARM clock, micros() follows F_CPU_ACTUAL
+ * K66: I2S MCLK is divided from F_CPU (I2S_dividers), so the clock stays F_CPU;
+ *     the load is still measured and the lowest sufficient F_CPU is suggested
+ * host: clock is bookkeeping only (exercises the governor)
+ */
+#ifndef _GOVERNOR_H
+#define _GOVERNOR_H
+
+#include <stdint.h>
+
+#ifndef GOV_WINDOW
+  #define GOV_WINDOW 1000 // ms, load measurement
+#endif
+#ifndef GOV_LOAD
+  #define GOV_LOAD 50     // %, highest load allowed at chosen clock
+#endif
+#ifndef GOV_HOLD
+  #define GOV_HOLD 3      // windows before clock is lowered
+#endif
+
+#if defined(__IMXRT1062__)
+  extern "C" uint32_t set_arm_clock(uint32_t frequency);
+  static const uint32_t govClocks[] = {24000000, 150000000, 396000000, 528000000, 600000000};
+  static uint32_t govSet(uint32_t fcpu) { return set_arm_clock(fcpu); }
+#elif defined(HOST_BUILD)
+  static const uint32_t govClocks[] = {24000000, 150000000, 396000000, 528000000, 600000000};
+  static uint32_t govSet(uint32_t fcpu) { return fcpu; }
+#else
+  static const uint32_t govClocks[] = {F_CPU};
+  static uint32_t govSet(uint32_t fcpu) { return F_CPU; }
+  // clocks the K66 can be built for (Tools menu), only suggested
+  static const uint32_t govBuildClocks[] = {24000000, 48000000, 72000000, 96000000, 120000000, 144000000, 168000000, 180000000};
+#endif
+#define GOV_NCLOCK (sizeof(govClocks)/sizeof(govClocks[0]))
+
+class c_governor
+{
+  public:
+    // start at highest clock (setup, first window)
+    void begin(void)
+    { ic = GOV_NCLOCK-1;
+      fcpu = govSet(govClocks[ic]);
+      tWin = millis(); tBusy = 0; nLow = 0; boosted = 0; load = 0;
+    }
+
+    void busy(uint32_t us) { tBusy += us; }
+
+    // once per loop(): backlog is audio blocks waiting in queue
+    void update(uint32_t backlog, uint32_t maxBacklog)
+    {
+      if(backlog > maxBacklog) boost(1);
+      else if(boosted && backlog <= 1) boost(0);
+
+      uint32_t dt = millis() - tWin;
+      if(dt < GOV_WINDOW) return;
+      load = (uint32_t) ((uint64_t) tBusy*100/(1000*dt)); // at clock of (most of) window
+      uint64_t cycles = (uint64_t) tBusy*fcpu/(1000*(uint64_t) dt); // cycles/s needed
+      tWin += dt; tBusy = 0;
+      if(boosted) return;
+
+      uint32_t in = 0;
+      while(in < GOV_NCLOCK-1 && cycles*100 > (uint64_t) GOV_LOAD*govClocks[in]) in++;
+      if(in > ic) { nLow = 0; set(in); }
+      else if(in < ic) { if(++nLow >= GOV_HOLD) { nLow = 0; set(in); } }
+      else nLow = 0;
+      #if !defined(__IMXRT1062__) && !defined(HOST_BUILD)
+        suggest = 0;
+        for(uint32_t ii=0; ii<sizeof(govBuildClocks)/4 && !suggest; ii++)
+          if(cycles*100 <= (uint64_t) GOV_LOAD*govBuildClocks[ii]) suggest = govBuildClocks[ii];
+      #endif
+    }
+
+    // highest clock until boost(0)
+    void boost(int on)
+    { if(on == boosted) return;
+      boosted = on;
+      fcpu = govSet(govClocks[on? GOV_NCLOCK-1: ic]);
+      if(on) nBoost++;
+      else { tWin = millis(); tBusy = 0; } // window at one clock
+    }
+
+    uint32_t clock(void) { return fcpu; }
+    uint32_t fcpu;      // current clock
+    uint32_t load;      // % busy in last window
+    uint32_t suggest=0; // K66: lowest build clock (F_CPU) for last window's load
+    uint32_t nBoost=0;  // boosts
+
+  private:
+    void set(uint32_t in) { ic = in; fcpu = govSet(govClocks[ic]); }
+
+    uint32_t ic;        // index of chosen clock
+    uint32_t tWin;      // start of window (ms)
+    uint32_t tBusy;     // us busy in window
+    uint32_t nLow;      // windows in a row that allowed a lower clock
+    int boosted;
+};
+
+#endif
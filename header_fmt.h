@@ -0,0 +1,147 @@
+/* SGTL5000 Recorder for Teensy
+ * Copyright (c) 2018, Walter Zimmer
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice, development funding notice, and this permission
+ * notice shall be included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+/*
+ * header of .bin files (first 512 bytes, one sector), little endian
+ *
+ * bytes 0..83 keep the layout of the original header (version 1, no descriptor),
+ * so that existing readers continue to work; version 2 adds a format descriptor
+ * behind HDR_EXT_MAGIC and a CRC-32 over bytes 0..507
+ * shared by recorder (main.cpp) and host reader (host/bin_header.h)
+ */
+#ifndef _HEADER_FMT_H
+#define _HEADER_FMT_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+
+#define HDR_MAGIC     "WMXZ"
+#define HDR_EXT_MAGIC "HDRX"
+#define HDR_VERSION   2
+#define HDR_SIZE      512
+
+#define HDR_CODEC_PCM 1 // signed integer, little endian, nbyte per sample
+
+typedef struct __attribute__((packed))
+{ uint8_t codec;      // HDR_CODEC_*
+  uint8_t nbyte;      // bytes per sample
+  uint8_t validBits;  // significant bits per sample (LSB aligned in .bin, MSB aligned in WAV)
+  uint8_t nch;        // channels per frame
+  uint8_t chanMap[8]; // source (I2S slot) of each channel in frame
+} hdrFormat_t;
+
+// boot profile (first file after reset or wake-up): micros() since reset at end of each phase of setup()
+#define HDR_BOOT_ENTRY  0 // setup() entered (core startup)
+#define HDR_BOOT_RTC    1 // RTC read and Time library synchronized
+#define HDR_BOOT_MEMORY 2 // audio block pool allocated (mAudioMemory)
+#define HDR_BOOT_CODEC  3 // codec enabled and input selected
+#define HDR_BOOT_I2S    4 // I2S clocks (PLL) set and codec clock adapted
+#define HDR_BOOT_SCHED  5 // schedule compiled and checked
+#define HDR_BOOT_SD     6 // uSD mounted (uSD.init)
+#define HDR_BOOT_SDTEST 7 // uSD write test (c_uSD::characterize), if any
+#define HDR_BOOT_START  8 // end of setup()
+#define HDR_BOOT_FIRST  9 // first audio block complete in queue (in loop())
+#define HDR_BOOT_PHASES 10
+#define HDR_BOOT_NAMES {"entry", "rtc", "memory", "codec", "i2s", "sched", "sd", "sdtest", "start", "first"}
+
+#define HDR_BOOT_WARM 1 // flags: warm wake-up (retain.h)
+
+typedef struct __attribute__((packed))
+{ uint8_t nphase;     // valid entries in t (0: no profile)
+  uint8_t flags;      // HDR_BOOT_*
+  uint16_t spare;
+  uint32_t t[HDR_BOOT_PHASES]; // us since reset
+} hdrBoot_t;
+
+// uSD card identification (from CID register), all zero: card not identified
+typedef struct __attribute__((packed))
+{ uint8_t mid;    // manufacturer ID
+  char oid[2];    // OEM/application ID
+  char pnm[5];    // product name
+  uint8_t prv;    // product revision (BCD, n.m)
+  uint32_t psn;   // serial number
+  uint16_t year;  // manufacturing date
+  uint8_t month;
+} hdrCard_t;
+
+typedef struct __attribute__((packed))
+{ // version 1 (original layout)
+  char magic[4];        // HDR_MAGIC
+  char date[20];        // yyyy_mm_dd_hh_mm_ss of file start, 0 terminated
+  uint32_t millis;
+  uint32_t micros;
+  uint32_t fsamp;
+  uint32_t a_on, a_off, t_on;
+  uint16_t r_h1s, r_h1e, r_h2s, r_h2e;
+  uint16_t nch, nbyte;
+  uint16_t sel_lr, audio_select, mic_gain, audio_mode;
+  uint32_t cardRate;        // bytes/s (0: card not characterized)
+  uint32_t cardMaxLatency;  // us
+  uint32_t writeChunk;      // bytes
+  uint32_t markSize;        // inline drop markers (marker_fmt.h), 0: none
+  // version 2
+  char extMagic[4];     // HDR_EXT_MAGIC
+  uint16_t version;     // HDR_VERSION
+  uint16_t size;        // offset of first sample (HDR_SIZE, 1024 in WAV files)
+  uint32_t rtc;         // file start, seconds since 1970 (as date)
+  uint32_t blockSamples;// samples per channel and audio block
+  uint32_t bufferBytes; // disk buffer
+  hdrFormat_t format;
+  hdrBoot_t boot;       // zero in other files
+  hdrCard_t card;       // zero in files of older versions
+  uint8_t reserved[HDR_SIZE-120-sizeof(hdrBoot_t)-sizeof(hdrCard_t)];
+  uint32_t crc;         // CRC-32 of bytes 0..507
+} hdr_t;
+
+static_assert(sizeof(hdrFormat_t) == 12, "hdrFormat_t must be 12 bytes");
+static_assert(sizeof(hdrBoot_t) == 44, "hdrBoot_t must be 44 bytes");
+static_assert(sizeof(hdrCard_t) == 16, "hdrCard_t must be 16 bytes");
+static_assert(sizeof(hdr_t) == HDR_SIZE, "hdr_t must be one sector");
+static_assert(offsetof(hdr_t, fsamp) == 32 && offsetof(hdr_t, nch) == 56
+           && offsetof(hdr_t, cardRate) == 68 && offsetof(hdr_t, markSize) == 80,
+              "hdr_t must keep original layout");
+static_assert(offsetof(hdr_t, crc) == HDR_SIZE-4, "crc must be last word");
+
+// CID register as sent by card (16 bytes, most significant byte first)
+static inline void hdrCardFromCID(hdrCard_t &cc, const uint8_t *cid)
+{ cc.mid = cid[0];
+  memcpy(cc.oid, cid+1, 2);
+  memcpy(cc.pnm, cid+3, 5);
+  cc.prv = cid[8];
+  cc.psn = ((uint32_t) cid[9]<<24) | ((uint32_t) cid[10]<<16) | ((uint32_t) cid[11]<<8) | cid[12];
+  cc.year = 2000 + (((cid[13] & 0xf)<<4) | (cid[14]>>4));
+  cc.month = cid[14] & 0xf;
+}
+
+// CRC-32 (IEEE 802.3, reflected), bitwise: runs once per file on device
+static inline uint32_t hdrCrc(const void *data, uint32_t nbytes)
+{ const uint8_t *pp = (const uint8_t *) data;
+  uint32_t crc = 0xffffffff;
+  while(nbytes--)
+  { crc ^= *pp++;
+    for(int ii=0; ii<8; ii++) crc = (crc >> 1) ^ (0xedb88320 & (0 - (crc & 1)));
+  }
+  return ~crc;
+}
+
+#endif
@@ -251,5 +251,12 @@ void setWakeupCallandSleep(uint32_t nsec)
   rtc_setAlarm(to+nsec);
   doShutdown();
 }
+
+#elif defined(HOST_BUILD)
+/*********************************************************************************/
+void setWakeupCallandSleep(uint32_t nsec)
+{
+  hal_hibernate(nsec); // ends simulation
+}
 #endif
 #endif
\ No newline at end of file
@@ -0,0 +1,47 @@
+// host replacement of Teensy DMAChannel.h
+// only the circular receive buffer with half and major loop interrupts
+// as used by I2S_32 is emulated (see hal_host.cpp)
+#ifndef DMAChannel_h_
+#define DMAChannel_h_
+
+#include "hal_host.h"
+
+#define DMA_TCD_ATTR_SSIZE(n) (((n) & 0x7) << 8)
+#define DMA_TCD_ATTR_DSIZE(n) ((n) & 0x7)
+#define DMA_TCD_CSR_INTMAJOR 0x0002
+#define DMA_TCD_CSR_INTHALF  0x0004
+
+typedef struct
+{
+  volatile const void * volatile SADDR;
+  int16_t SOFF;
+  uint16_t ATTR;
+  uint32_t NBYTES_MLNO;
+  int32_t SLAST;
+  volatile void * volatile DADDR;
+  int16_t DOFF;
+  uint16_t CITER_ELINKNO;
+  int32_t DLASTSGA;
+  uint16_t CSR;
+  uint16_t BITER_ELINKNO;
+} DMA_TCD_t;
+
+class DMAChannel
+{
+  public:
+    DMAChannel(bool allocate=true) { TCD=&tcd; }
+    void begin(bool force=false) { TCD=&tcd; }
+    void triggerAtHardwareEvent(uint8_t source) { }
+    void enable(void);
+    void disable(void);
+    void attachInterrupt(void (*isr)(void)) { this->isr=isr; }
+    void clearInterrupt(void) { }
+
+    DMA_TCD_t *TCD;
+    void (*isr)(void)=0;
+
+  private:
+    DMA_TCD_t tcd;
+};
+
+#endif
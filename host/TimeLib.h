@@ -0,0 +1,33 @@
+// host replacement of TimeLib.h (Time library), based on the simulated RTC
+#ifndef _Time_h
+#define _Time_h
+
+#include <time.h>
+#include "hal_host.h"
+
+typedef enum { timeNotSet, timeNeedsSync, timeSet } timeStatus_t;
+typedef time_t (*getExternalTime)();
+
+static getExternalTime hal_syncProvider = 0;
+
+static inline void setSyncProvider(getExternalTime getTimeFunction) { hal_syncProvider = getTimeFunction; }
+static inline timeStatus_t timeStatus(void) { return hal_syncProvider? timeSet: timeNotSet; }
+static inline time_t now(void) { return hal_syncProvider? hal_syncProvider(): (time_t) rtc_get(); }
+
+static inline struct tm hal_tm(time_t t) { struct tm tx; gmtime_r(&t, &tx); return tx; }
+
+static inline int year(time_t t)   { return hal_tm(t).tm_year+1900; }
+static inline int month(time_t t)  { return hal_tm(t).tm_mon+1; }
+static inline int day(time_t t)    { return hal_tm(t).tm_mday; }
+static inline int hour(time_t t)   { return hal_tm(t).tm_hour; }
+static inline int minute(time_t t) { return hal_tm(t).tm_min; }
+static inline int second(time_t t) { return hal_tm(t).tm_sec; }
+
+static inline int year(void)   { return year(now()); }
+static inline int month(void)  { return month(now()); }
+static inline int day(void)    { return day(now()); }
+static inline int hour(void)   { return hour(now()); }
+static inline int minute(void) { return minute(now()); }
+static inline int second(void) { return second(now()); }
+
+#endif
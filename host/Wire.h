@@ -0,0 +1,19 @@
+// host replacement of Wire.h, all I2C transfers succeed (codec is not simulated)
+#ifndef TwoWire_h
+#define TwoWire_h
+
+#include "hal_host.h"
+
+class TwoWire
+{
+  public:
+    void begin(void) { }
+    void beginTransmission(int address) { }
+    size_t write(int data) { return 1; }
+    uint8_t endTransmission(bool sendStop=true) { return 0; }
+    uint8_t requestFrom(int address, int quantity) { return quantity; }
+    int read(void) { return 0; }
+};
+static TwoWire Wire;
+
+#endif
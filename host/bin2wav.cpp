@@ -0,0 +1,333 @@
+/* SGTL5000 Recorder for Teensy
+ * Copyright (c) 2018, Walter Zimmer
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice, development funding notice, and this permission
+ * notice shall be included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+// convert .bin recordings to WAV (RF64 above 4 GB)
+//
+// usage: bin2wav [-o outdir] [-j threads] [-k MB] [-c] [-n] [-q] path ...
+//   path  .bin file or directory (searched recursively)
+//   -o    output directory, relative paths are kept (default: next to input)
+//   -j    worker threads (default: number of hardware threads)
+//   -k    chunk size in MB (default 8)
+//   -c    one mono file per channel (<name>_ch<i>.wav) instead of interleaved
+//   -n    do not fill lost frames (drop markers) with silence
+//   -q    no listing
+//
+// input files are mapped into memory and cut into chunks; a pool of threads works
+// on all chunks of all files: with drop markers, chunks are first scanned for markers
+// (to know where each chunk goes in the output), then converted. output files are
+// created at full size, chunks are written with pwrite at their position, lost frames
+// stay as holes (zeros). interleaved 16 bit data go from the mapping to the file
+// without copy; 32 bit data with 24 valid bits are shifted to MSB as WAV requires
+// the recorder header is kept as chunk 'wmxz'
+
+#include <unistd.h>
+#include <dirent.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include <string>
+#include <vector>
+#include <atomic>
+
+#include "tools.h"
+#include "bin_header.h"
+#include "../marker_fmt.h"
+#include "../wav_fmt.h"
+
+static c_pool pool;
+
+//---------------------------------- options -------------------------------------
+static const char *outDir = 0;
+static uint64_t chunkBytes = 8<<20;
+static int splitChannels = 0;
+static int fillGaps = 1;
+static int quiet = 0;
+
+static std::atomic<uint64_t> bytesIn(0), bytesOut(0);
+static std::atomic<uint32_t> nDone(0), nErr(0), nMarks(0);
+
+//---------------------------------- conversion ----------------------------------
+typedef struct
+{ uint64_t offset;  // in input file
+  uint32_t frames;  // lost
+} mark_t;
+
+typedef struct
+{ uint64_t begin, end;     // input bytes
+  std::vector<mark_t> marks;
+  uint64_t outFrame;       // first output frame
+} chunk_t;
+
+typedef struct
+{ std::string path, outPath, root;
+  const uint8_t *map;
+  uint64_t size;
+  binInfo_t info;
+  uint32_t frameBytes;
+  uint32_t shift;          // left shift to MSB align samples
+  std::vector<chunk_t> chunks;
+  std::atomic<int> pending;
+  std::vector<int> fd;     // one, or one per channel
+  uint32_t hdrBytes;
+} job_t;
+
+static void fail(job_t *job, const char *what)
+{ fprintf(stderr, "%s: %s%s%s\n", job->path.c_str(), what, errno? ": ": "", errno? strerror(errno): "");
+  nErr++;
+}
+
+static void finish(job_t *job)
+{ for(int fd: job->fd) close(fd);
+  munmap((void *) job->map, job->size);
+  nDone++;
+  if(!quiet) printf("%s -> %s\n", job->path.c_str(), job->outPath.c_str());
+  delete job;
+}
+
+// write frames [src, src+nframes) of chunk to output frame outFrame
+static void writeFrames(job_t *job, const uint8_t *src, uint64_t nframes, uint64_t outFrame)
+{
+  const uint32_t nch = job->info.nch, nbyte = job->info.nbyte, fb = job->frameBytes;
+  if(!splitChannels && !job->shift)
+  { // straight from mapping
+    uint64_t off = job->hdrBytes + outFrame*fb, nb = nframes*fb;
+    while(nb)
+    { ssize_t nw = pwrite(job->fd[0], src, nb, off);
+      if(nw<=0) { fail(job, "write"); return; }
+      src += nw; off += nw; nb -= nw;
+    }
+    bytesOut += nframes*fb;
+    return;
+  }
+
+  static thread_local std::vector<uint8_t> buf(1<<20);
+  uint32_t nbuf = buf.size()/fb;
+  for(uint64_t f0=0; f0<nframes; f0+=nbuf)
+  { uint32_t nf = (nframes-f0 < nbuf)? nframes-f0: nbuf;
+    const uint8_t *pp = src + f0*fb;
+    for(uint32_t ch=0; ch<(splitChannels? nch: 1); ch++)
+    { uint8_t *qq = buf.data();
+      uint32_t ns = splitChannels? nf: nf*nch;        // samples to write
+      uint32_t stride = splitChannels? fb: nbyte;     // input step
+      const uint8_t *ss = pp + (splitChannels? ch*nbyte: 0);
+      if(nbyte==2)
+      { for(uint32_t ii=0; ii<ns; ii++, ss+=stride, qq+=2) memcpy(qq, ss, 2);
+      }
+      else
+      { for(uint32_t ii=0; ii<ns; ii++, ss+=stride, qq+=4)
+        { uint32_t vv; memcpy(&vv, ss, 4); vv <<= job->shift; memcpy(qq, &vv, 4); }
+      }
+      uint64_t obytes = (uint64_t) ns*nbyte;
+      uint64_t off = job->hdrBytes + (outFrame+f0)*(splitChannels? nbyte: fb);
+      const uint8_t *ww = buf.data();
+      while(obytes)
+      { ssize_t nw = pwrite(job->fd[ch], ww, obytes, off);
+        if(nw<=0) { fail(job, "write"); return; }
+        ww += nw; off += nw; obytes -= nw;
+      }
+      bytesOut += (uint64_t) ns*nbyte;
+    }
+  }
+}
+
+static void convert(job_t *job, chunk_t *ck)
+{
+  uint64_t cur = ck->begin, outFrame = ck->outFrame;
+  for(auto &mk: ck->marks)
+  { uint64_t nf = (mk.offset - cur)/job->frameBytes;
+    writeFrames(job, job->map + cur, nf, outFrame);
+    outFrame += nf + (fillGaps? mk.frames: 0);
+    cur = mk.offset + sizeof(markRecord_t);
+  }
+  writeFrames(job, job->map + cur, (ck->end - cur)/job->frameBytes, outFrame);
+  bytesIn += ck->end - ck->begin;
+  madvise((void *) ((uintptr_t) (job->map + ck->begin) & ~(uintptr_t) 4095),
+    ck->end - ck->begin, MADV_DONTNEED); // done with these pages
+  if(job->pending.fetch_sub(1) == 1) finish(job);
+}
+
+static void setup(job_t *job);
+
+static void scan(job_t *job, chunk_t *ck)
+{
+  for(uint64_t off = ck->begin; off < ck->end; off += sizeof(markRecord_t))
+    if(markValid(job->map + off))
+    { const markRecord_t *mr = (const markRecord_t *) (job->map + off);
+      ck->marks.push_back({off, mr->frames});
+    }
+  if(job->pending.fetch_sub(1) == 1) setup(job);
+}
+
+// output positions of chunks known: create output, queue conversion
+static void setup(job_t *job)
+{
+  uint64_t frames = 0;
+  for(auto &ck: job->chunks)
+  { ck.outFrame = frames;
+    frames += (ck.end - ck.begin - ck.marks.size()*sizeof(markRecord_t))/job->frameBytes;
+    if(fillGaps) for(auto &mk: ck.marks) frames += mk.frames;
+    nMarks += ck.marks.size();
+  }
+
+  wavFormat_t fmt;
+  fmt.fsamp = job->info.fsamp;
+  fmt.nch = splitChannels? 1: job->info.nch;
+  fmt.nbyte = job->info.nbyte;
+  fmt.validBits = job->info.format.validBits;
+  fmt.chanMask = 0;
+  uint64_t dataBytes = frames*fmt.nch*fmt.nbyte;
+  uint8_t hdr[WAV_MIN_HEADER + 8 + HDR_SIZE];
+  job->hdrBytes = wavHeader(hdr, fmt, dataBytes, &job->info.raw, HDR_SIZE, 0);
+
+  std::string base = job->path.substr(0, job->path.size()-4);
+  if(outDir) base = std::string(outDir) + "/" + base.substr(job->root.size());
+  mkdirs(base);
+  for(int ch=0; ch<(splitChannels? job->info.nch: 1); ch++)
+  { std::string name = base;
+    if(splitChannels) name += "_ch" + std::to_string(ch);
+    name += ".wav";
+    if(!ch) job->outPath = name;
+    int fd = open(name.c_str(), O_WRONLY|O_CREAT|O_TRUNC, 0644);
+    if(fd<0 || pwrite(fd, hdr, job->hdrBytes, 0) != (ssize_t) job->hdrBytes
+        || ftruncate(fd, job->hdrBytes + dataBytes))
+    { errno = errno? errno: EIO;
+      fail(job, name.c_str());
+      if(fd>=0) close(fd);
+      for(int ff: job->fd) close(ff);
+      job->fd.clear();
+      munmap((void *) job->map, job->size);
+      delete job;
+      return;
+    }
+    job->fd.push_back(fd);
+  }
+
+  job->pending = job->chunks.size();
+  for(auto &ck: job->chunks) pool.push([job, &ck] { convert(job, &ck); });
+}
+
+static void openJob(const std::string &path, const std::string &root)
+{
+  job_t *job = new job_t;
+  job->path = path;
+  job->root = root;
+  errno = 0;
+  int fd = open(path.c_str(), O_RDONLY);
+  struct stat st;
+  if(fd<0 || fstat(fd, &st)) { fail(job, "open"); if(fd>=0) close(fd); delete job; return; }
+  job->size = st.st_size;
+  job->map = (const uint8_t *) mmap(0, job->size? job->size: 1, PROT_READ, MAP_SHARED, fd, 0);
+  close(fd);
+  if(job->map == MAP_FAILED) { fail(job, "mmap"); delete job; return; }
+  madvise((void *) job->map, job->size, MADV_SEQUENTIAL);
+
+  int err = hdrParse(job->map, job->size, job->info);
+  if(err)
+  { errno = 0;
+    fail(job, hdrError(err));
+    munmap((void *) job->map, job->size);
+    delete job;
+    return;
+  }
+  job->frameBytes = job->info.nch*job->info.nbyte;
+  job->shift = 8*job->info.nbyte - job->info.format.validBits;
+
+  // chunks: multiples of 32 bytes (marker alignment) and of frames
+  uint64_t data0 = job->info.dataOffset;
+  uint64_t ndata = (job->size - data0)/job->frameBytes*job->frameBytes;
+  uint64_t step = chunkBytes - chunkBytes % (32*job->frameBytes);
+  for(uint64_t off=0; off<ndata || !off; off+=step)
+  { chunk_t ck;
+    ck.begin = data0 + off;
+    ck.end = data0 + ((off+step < ndata)? off+step: ndata);
+    ck.outFrame = 0;
+    job->chunks.push_back(ck);
+    if(!ndata) break;
+  }
+
+  if(job->info.markSize == sizeof(markRecord_t))
+  { job->pending = job->chunks.size();
+    for(auto &ck: job->chunks) pool.push([job, &ck] { scan(job, &ck); });
+  }
+  else
+    setup(job);
+}
+
+//---------------------------------- main ----------------------------------------
+static void walk(const std::string &path, const std::string &root)
+{ struct stat st;
+  if(stat(path.c_str(), &st)) { perror(path.c_str()); nErr++; return; }
+  if(!S_ISDIR(st.st_mode)) { pool.push([path, root] { openJob(path, root); }); return; }
+  DIR *dp = opendir(path.c_str());
+  if(!dp) return;
+  while(struct dirent *de = readdir(dp))
+  { if(de->d_name[0]=='.') continue;
+    size_t len = strlen(de->d_name);
+    std::string name = path + "/" + de->d_name;
+    if(len>4 && !strcmp(de->d_name+len-4, ".bin")) walk(name, root);
+    else if(de->d_type==DT_DIR || de->d_type==DT_UNKNOWN) walk(name, root);
+  }
+  closedir(dp);
+}
+
+int main(int argc, char *argv[])
+{
+  int nthreads = std::thread::hardware_concurrency();
+  int opt;
+  while((opt = getopt(argc, argv, "o:j:k:cnq")) != -1)
+  { switch(opt)
+    { case 'o': outDir = optarg; break;
+      case 'j': nthreads = atoi(optarg); break;
+      case 'k': chunkBytes = (uint64_t) atof(optarg)*(1<<20); break;
+      case 'c': splitChannels = 1; break;
+      case 'n': fillGaps = 0; break;
+      case 'q': quiet = 1; break;
+      default:
+        fprintf(stderr, "usage: %s [-o outdir] [-j threads] [-k MB] [-c] [-n] [-q] path ...\n", argv[0]);
+        return 1;
+    }
+  }
+  if(nthreads < 1) nthreads = 1;
+  if(chunkBytes < 1<<16) chunkBytes = 1<<16;
+
+  struct timespec t0, t1;
+  clock_gettime(CLOCK_MONOTONIC, &t0);
+  for(int ii=optind; ii<argc; ii++)
+  { std::string root = argv[ii];
+    while(root.size()>1 && root.back()=='/') root.pop_back();
+    struct stat st;
+    // relative output path: below directory argument, or file name only
+    std::string base = (!stat(root.c_str(), &st) && S_ISDIR(st.st_mode))? root:
+      root.substr(0, root.rfind('/')==std::string::npos? 0: root.rfind('/'));
+    walk(root, base);
+  }
+  pool.run(nthreads);
+  clock_gettime(CLOCK_MONOTONIC, &t1);
+
+  double dt = (t1.tv_sec-t0.tv_sec) + 1e-9*(t1.tv_nsec-t0.tv_nsec);
+  fprintf(stderr, "%u files, %u errors, %u drop markers, %.2f GB in, %.2f GB out, %.2f s, %.0f MB/s (%d threads)\n",
+    (uint32_t) nDone, (uint32_t) nErr, (uint32_t) nMarks, bytesIn*1e-9, bytesOut*1e-9, dt,
+    dt>0? bytesIn*1e-6/dt: 0, nthreads);
+  return nErr? 2: 0;
+}
@@ -0,0 +1,142 @@
+/* SGTL5000 Recorder for Teensy
+ * Copyright (c) 2018, Walter Zimmer
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice, development funding notice, and this permission
+ * notice shall be included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+/*
+ * header-only host parser of .bin headers (header_fmt.h)
+ *
+ *   binInfo_t info;
+ *   int err = hdrRead("WMXZ_100000.bin", info);   // HDR_OK or HDR_E*
+ *
+ * one pread per file, no allocation; version 1 headers (without descriptor) are
+ * accepted and their format is derived from NCH, NBYTE and SEL_LR
+ * WAV files written by the recorder (OUT_WAV) are parsed from their chunk 'wmxz'
+ * requires a little endian host (as the recorder)
+ */
+#ifndef _BIN_HEADER_H
+#define _BIN_HEADER_H
+
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+#include "../header_fmt.h"
+
+#if defined(__BYTE_ORDER__) && (__BYTE_ORDER__ != __ORDER_LITTLE_ENDIAN__)
+  #error "bin_header.h: big endian hosts are not supported"
+#endif
+
+enum { HDR_OK=0, HDR_EREAD, HDR_EMAGIC, HDR_ECRC, HDR_EVERSION, HDR_EFORMAT };
+
+typedef struct
+{ int version;          // 1: original header, 2: with descriptor
+  uint32_t rtc;         // file start, seconds since 1970
+  uint32_t fsamp;
+  uint16_t nch, nbyte;
+  uint32_t markSize;    // drop marker size (0: none)
+  uint32_t dataOffset;  // first sample
+  int wav;              // WAV file (samples MSB aligned, no drop markers)
+  hdrFormat_t format;
+  hdr_t raw;
+} binInfo_t;
+
+static inline const char *hdrError(int err)
+{ static const char *msg[] = {"ok", "read error", "no header", "crc error", "unknown version", "bad format"};
+  return (err>=0 && err<=HDR_EFORMAT)? msg[err]: "?";
+}
+
+static inline int hdrParse(const void *buf, size_t nbytes, binInfo_t &info)
+{
+  const uint8_t *bb = (const uint8_t *) buf;
+  if(nbytes >= 12 && (!memcmp(bb, "RIFF", 4) || !memcmp(bb, "RF64", 4)) && !memcmp(bb+8, "WAVE", 4))
+  { // WAV: recorder header in chunk 'wmxz', data offset from chunk 'data'
+    size_t pos = 12, meta = 0;
+    while(pos+8 <= nbytes)
+    { uint32_t size;
+      memcpy(&size, bb+pos+4, 4);
+      if(!memcmp(bb+pos, "wmxz", 4) && size >= HDR_SIZE) meta = pos+8;
+      if(!memcmp(bb+pos, "data", 4)) break;
+      pos += 8 + size + (size & 1);
+    }
+    if(!meta || pos+8 > nbytes) return meta? HDR_EREAD: HDR_EMAGIC;
+    int err = hdrParse(bb+meta, HDR_SIZE, info);
+    if(err) return err;
+    info.dataOffset = pos+8;
+    info.markSize = 0;
+    info.wav = 1;
+    return HDR_OK;
+  }
+
+  if(nbytes < HDR_SIZE) return HDR_EREAD;
+  memcpy(&info.raw, buf, HDR_SIZE);
+  info.wav = 0;
+  const hdr_t &hh = info.raw;
+  if(memcmp(hh.magic, HDR_MAGIC, 4)) return HDR_EMAGIC;
+
+  info.fsamp = hh.fsamp;
+  info.nch = hh.nch;
+  info.nbyte = hh.nbyte;
+  info.markSize = hh.markSize;
+  info.dataOffset = HDR_SIZE;
+
+  if(!memcmp(hh.extMagic, HDR_EXT_MAGIC, 4))
+  { if(hh.crc != hdrCrc(&hh, offsetof(hdr_t, crc))) return HDR_ECRC;
+    if(hh.version < 2 || hh.version > HDR_VERSION) return HDR_EVERSION;
+    info.version = hh.version;
+    info.rtc = hh.rtc;
+    info.format = hh.format;
+    info.dataOffset = hh.size;
+  }
+  else
+  { // version 1: time from date string, format from fixed fields
+    info.version = 1;
+    struct tm tx = {};
+    if(sscanf(hh.date, "%4d_%2d_%2d_%2d_%2d_%2d", &tx.tm_year, &tx.tm_mon, &tx.tm_mday,
+              &tx.tm_hour, &tx.tm_min, &tx.tm_sec) != 6) return HDR_EFORMAT;
+    tx.tm_year -= 1900; tx.tm_mon -= 1;
+    info.rtc = (uint32_t) timegm(&tx);
+    memset(&info.format, 0, sizeof(info.format));
+    info.format.codec = HDR_CODEC_PCM;
+    info.format.nbyte = hh.nbyte;
+    info.format.validBits = 8*hh.nbyte;
+    info.format.nch = hh.nch;
+    for(int ii=0; ii<hh.nch && ii<8; ii++) info.format.chanMap[ii] = (hh.nch==1)? hh.sel_lr: ii;
+  }
+
+  if(!info.fsamp || info.nch<1 || info.nch>8 || (info.nbyte!=2 && info.nbyte!=4)
+      || info.format.nch!=info.nch || info.format.nbyte!=info.nbyte || info.format.codec!=HDR_CODEC_PCM
+      || info.dataOffset < HDR_SIZE)
+    return HDR_EFORMAT;
+  return HDR_OK;
+}
+
+static inline int hdrRead(const char *path, binInfo_t &info)
+{ int fd = open(path, O_RDONLY);
+  if(fd<0) return HDR_EREAD;
+  char buf[4096]; // WAV header with metadata
+  ssize_t nb = pread(fd, buf, sizeof(buf), 0);
+  close(fd);
+  return hdrParse(buf, (nb>0)? nb: 0, info);
+}
+
+#endif
@@ -0,0 +1,311 @@
+/* SGTL5000 Recorder for Teensy
+ * Copyright (c) 2018, Walter Zimmer
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice, development funding notice, and this permission
+ * notice shall be included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+/*
+ * header-only host reader: time to file offset lookup in a recorder tree
+ *   <root>/<DirPrefix>_yyyymmdd/hh/<FilePrefix>_hhmmss.bin|wav (+ .idx sidecar)
+ *
+ *   c_binIndex bx;
+ *   bx.scan("/media/sdcard");       // sorts all files by start time
+ *   binPos_t pos;
+ *   if(bx.lookup(t, pos)) ...       // t: seconds since 1970 (UTC as RTC)
+ *
+ * lookup is O(log n) in files and O(log m) in index entries of a file
+ * index times: entries carry RTC seconds and micros(); the sub-second anchor of
+ * a file is the intersection of the intervals [rtc - dt, rtc + 1 - dt) of all entries
+ * (dt: micros since first entry). neighbouring files of the same run share micros(),
+ * so their intervals are intersected as well (up to IDX_CHAIN files each side)
+ * files without sidecar are located from the header (fs, NCH, NBYTE, see bin_header.h)
+ * drop markers (marker_fmt.h) between index entry and target are skipped, and
+ * the frames they report lost are taken into account (times within a gap are not found)
+ */
+#ifndef _BIN_INDEX_H
+#define _BIN_INDEX_H
+
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+#include <math.h>
+#include <time.h>
+#include <dirent.h>
+#include <sys/stat.h>
+
+#include <string>
+#include <vector>
+#include <map>
+#include <algorithm>
+
+#include "../index_fmt.h"
+#include "../marker_fmt.h"
+#include "bin_header.h"
+
+#ifndef IDX_CHAIN
+  #define IDX_CHAIN 8
+#endif
+
+typedef struct
+{ std::string path;   // .bin file
+  double tstart;      // start time from directory and file name
+} binFile_t;
+
+typedef struct
+{ std::string path;   // .bin file
+  uint64_t offset;    // byte offset of frame
+  uint64_t sample;    // frame number within file
+  double tfile;       // start time of file
+} binPos_t;
+
+typedef struct
+{ uint64_t offset;    // byte offset of marker in .bin file
+  markRecord_t rec;
+} binMark_t;
+
+class c_binIndex
+{
+  public:
+    // index of a file (loaded on first use)
+    typedef struct
+    { uint32_t fsamp;
+      uint16_t nch, nbyte;
+      uint32_t markSize;              // size of drop markers (0: none)
+      uint32_t dataOffset;            // first sample
+      uint64_t size;                  // file size (bytes)
+      std::vector<idxEntry_t> ent;
+      std::vector<double> dt;         // micros of entries since first entry (s)
+      double lo, hi;                  // first entry was at [lo, hi)
+      std::vector<double> t;          // time of entries (after anchor)
+    } fileIndex_t;
+
+    // collect all .bin files below root, returns number of files
+    int scan(const char *root)
+    { list.clear();
+      cache.clear();
+      walk(root, 0, 0);
+      std::sort(list.begin(), list.end(),
+        [](const binFile_t &a, const binFile_t &b) { return a.tstart < b.tstart; });
+      return list.size();
+    }
+
+    const std::vector<binFile_t> &files(void) const { return list; }
+
+    // file and byte offset of the frame recorded at time t
+    bool lookup(double t, binPos_t &pos)
+    {
+      auto it = std::upper_bound(list.begin(), list.end(), t,
+        [](double tt, const binFile_t &f) { return tt < f.tstart; });
+      if(it == list.begin()) return false;
+      const binFile_t &bf = *(--it);
+
+      const fileIndex_t &ix = anchor(it - list.begin());
+      if(!ix.fsamp) return false;
+      uint32_t frameBytes = ix.nch*ix.nbyte;
+
+      pos.path = bf.path;
+      pos.tfile = bf.tstart;
+      if(ix.t.empty())
+      { pos.sample = (uint64_t) ((t - bf.tstart)*ix.fsamp + 0.5);
+        pos.offset = ix.dataOffset + pos.sample*frameBytes;
+      }
+      else
+      { size_t jj = std::upper_bound(ix.t.begin(), ix.t.end(), t) - ix.t.begin();
+        if(jj>0) jj--;
+        double dt = t - ix.t[jj];
+        if(dt<0) dt=0;
+        int64_t ds = (int64_t) (dt*ix.fsamp + 0.5);
+        uint64_t off = ix.ent[jj].offset;
+        pos.sample = ix.ent[jj].sample;
+        if(ix.markSize)
+        { // markers up to next entry (or end of file)
+          uint64_t end = (jj+1 < ix.ent.size())? ix.ent[jj+1].offset: ix.size;
+          std::vector<binMark_t> marks;
+          scanMarks(bf.path, off, end, marks);
+          for(auto &mk: marks)
+          { int64_t nf = (mk.offset - off)/frameBytes; // frames before marker
+            if(ds < nf) break;
+            ds -= nf + mk.rec.frames;
+            if(ds < 0) return false; // in gap
+            pos.sample += nf;
+            off = mk.offset + mk.rec.size;
+          }
+        }
+        pos.sample += ds;
+        pos.offset = off + ds*frameBytes;
+      }
+      return pos.offset < ix.size; // else: t is in gap after this file
+    }
+
+    // drop markers in byte range [from, to) of .bin file
+    static int scanMarks(const std::string &path, uint64_t from, uint64_t to, std::vector<binMark_t> &marks)
+    { FILE *fd = fopen(path.c_str(), "rb");
+      if(!fd) return 0;
+      from &= ~(uint64_t) (sizeof(markRecord_t)-1);
+      static thread_local uint8_t buf[1<<16];
+      int nm = 0;
+      while(from < to && !fseeko(fd, from, SEEK_SET))
+      { size_t nb = fread(buf, 1, (to-from < sizeof(buf))? to-from: sizeof(buf), fd);
+        nb &= ~(sizeof(markRecord_t)-1);
+        if(!nb) break;
+        for(size_t ii=0; ii<nb; ii+=sizeof(markRecord_t))
+          if(markValid(buf+ii))
+          { binMark_t mk;
+            mk.offset = from+ii;
+            memcpy(&mk.rec, buf+ii, sizeof(markRecord_t));
+            marks.push_back(mk);
+            nm++;
+          }
+        from += nb;
+      }
+      fclose(fd);
+      return nm;
+    }
+
+
+    // all drop markers of a file: only index intervals whose offsets run ahead of their
+    // samples are read (and the part behind the last entry), without index the whole file
+    static int indexMarks(const std::string &path, const fileIndex_t &ix, std::vector<binMark_t> &marks)
+    { if(!ix.markSize) return 0;
+      uint64_t fb = ix.nch*ix.nbyte, from = ix.dataOffset, skip = 0;
+      for(size_t ii=0; ii<=ix.ent.size(); ii++)
+      { uint64_t to = (ii<ix.ent.size())? ix.ent[ii].offset: ix.size;
+        uint64_t mb = (ii<ix.ent.size())? (to - ix.dataOffset) - ix.ent[ii].sample*fb: skip+1;
+        if(mb > skip) scanMarks(path, from, to, marks);
+        skip = mb;
+        from = to;
+      }
+      return marks.size();
+    }
+
+    const fileIndex_t &load(const binFile_t &bf)
+    { auto it = cache.find(bf.path);
+      if(it != cache.end()) return it->second;
+      fileIndex_t &ix = cache[bf.path];
+      ix.fsamp = 0; ix.nch = ix.nbyte = 0; ix.markSize = 0; ix.dataOffset = HDR_SIZE; ix.size = 0; ix.lo = ix.hi = 0;
+
+      struct stat st;
+      if(stat(bf.path.c_str(), &st)==0) ix.size = st.st_size;
+
+      std::string name = bf.path.substr(0, bf.path.size()-4) + ".idx";
+      if(FILE *fd = fopen(name.c_str(), "rb"))
+      { idxHeader_t hdr;
+        if(fread(&hdr, sizeof(hdr), 1, fd)==1 && !memcmp(hdr.magic, IDX_MAGIC, 4)
+            && hdr.entrySize==sizeof(idxEntry_t))
+        { ix.fsamp = hdr.fsamp; ix.nch = hdr.nch; ix.nbyte = hdr.nbyte;
+          idxEntry_t ee;
+          while(fread(&ee, sizeof(ee), 1, fd)==1) ix.ent.push_back(ee);
+        }
+        fclose(fd);
+      }
+      readHeader(bf.path, ix);
+      timeEntries(ix);
+      return ix;
+    }
+
+    // entry times of file ii, anchored with neighbours of same run
+    const fileIndex_t &anchor(size_t ii)
+    { fileIndex_t &ix = (fileIndex_t &) load(list[ii]);
+      if(ix.ent.empty() || !ix.t.empty()) return ix;
+      double lo = ix.lo, hi = ix.hi;
+      for(int dir=-1; dir<=1; dir+=2)
+      { for(int kk=1; kk<=IDX_CHAIN; kk++)
+        { long jj = (long) ii + dir*kk;
+          if(jj<0 || jj>=(long) list.size()) break;
+          const fileIndex_t &jx = load(list[jj]);
+          if(jx.ent.empty()) break;
+          double du = 1e-6*(int32_t) (jx.ent[0].usec - ix.ent[0].usec);
+          double dr = (double) jx.ent[0].rtc - (double) ix.ent[0].rtc;
+          if(fabs(du) > 2000 || fabs(dr-du) > 2) break; // other run or micros() ambiguous
+          lo = std::max(lo, jx.lo - du);
+          hi = std::min(hi, jx.hi - du);
+        }
+      }
+      if(lo > hi) { lo = ix.lo; hi = ix.hi; }
+      double t0 = 0.5*(lo+hi);
+      ix.t.resize(ix.ent.size());
+      for(size_t kk=0; kk<ix.ent.size(); kk++) ix.t[kk] = t0 + ix.dt[kk];
+      return ix;
+    }
+
+  private:
+    std::vector<binFile_t> list;
+    std::map<std::string, fileIndex_t> cache;
+
+    // header (bin_header.h): fs, NCH, NBYTE if there is no sidecar, and marker size
+    static void readHeader(const std::string &path, fileIndex_t &ix)
+    { binInfo_t info;
+      if(hdrRead(path.c_str(), info) != HDR_OK) return;
+      if(!ix.fsamp)
+      { ix.fsamp = info.fsamp;
+        ix.nch = info.nch;
+        ix.nbyte = info.nbyte;
+      }
+      ix.markSize = (info.markSize == sizeof(markRecord_t))? info.markSize: 0;
+      ix.dataOffset = info.dataOffset;
+    }
+
+    static void timeEntries(fileIndex_t &ix)
+    { size_t nn = ix.ent.size();
+      if(!nn) return;
+      ix.dt.resize(nn);
+      ix.lo = -1e30; ix.hi = 1e30;
+      ix.dt[0] = 0;
+      for(size_t ii=0; ii<nn; ii++)
+      { if(ii) ix.dt[ii] = ix.dt[ii-1] + 1e-6*(uint32_t) (ix.ent[ii].usec - ix.ent[ii-1].usec);
+        ix.lo = std::max(ix.lo, ix.ent[ii].rtc - ix.dt[ii]);
+        ix.hi = std::min(ix.hi, ix.ent[ii].rtc + 1.0 - ix.dt[ii]);
+      }
+      if(ix.lo > ix.hi) ix.lo = ix.hi - 1.0; // inconsistent (RTC set during recording)
+    }
+
+    // last number after '_' in name
+    static int number(const char *name, const char *fmt, int *a, int *b, int *c)
+    { const char *cp = strrchr(name, '_');
+      return cp? sscanf(cp+1, fmt, a, b, c): 0;
+    }
+
+    void walk(const std::string &dir, int level, double tday)
+    { DIR *dp = opendir(dir.c_str());
+      if(!dp) return;
+      while(struct dirent *de = readdir(dp))
+      { if(de->d_name[0]=='.') continue;
+        std::string path = dir + "/" + de->d_name;
+        int a, b, c;
+        size_t len = strlen(de->d_name);
+        if(len>4 && (!strcmp(de->d_name+len-4, ".bin") || !strcmp(de->d_name+len-4, ".wav")))
+        { if(number(de->d_name, "%2d%2d%2d", &a, &b, &c)==3)
+          { // tday includes hour from directory
+            double tday0 = tday - fmod(tday, 86400.0);
+            list.push_back({path, tday0 + 3600*a + 60*b + c});
+          }
+        }
+        else if(level==0 && number(de->d_name, "%4d%2d%2d", &a, &b, &c)==3)
+        { struct tm tx = {};
+          tx.tm_year = a-1900; tx.tm_mon = b-1; tx.tm_mday = c;
+          walk(path, 1, (double) timegm(&tx));
+        }
+        else if(level==1 && sscanf(de->d_name, "%2d", &a)==1)
+          walk(path, 2, tday + 3600*a);
+      }
+      closedir(dp);
+    }
+};
+
+#endif
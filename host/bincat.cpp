@@ -0,0 +1,244 @@
+/* SGTL5000 Recorder for Teensy
+ * Copyright (c) 2018, Walter Zimmer
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice, development funding notice, and this permission
+ * notice shall be included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+// catalog of recording trees (see catalog.h)
+//
+// usage: bincat [-c catalog] [-j threads] [-p] command ...
+//   update root ...   crawl trees in parallel and add/refresh their files in catalog
+//                     (only files with changed size or time are read again)
+//   query t0 t1       files with data between t0 and t1 (times as for binseek)
+//   list              all files
+//   bench [n]         time n random range queries (default 1000000)
+//   -c  catalog file (default catalog.wcat)
+//   -j  worker threads (default: number of hardware threads)
+//   -p  (update) remove files from catalog that no longer exist
+//
+// only headers (bin_header.h) and index sidecars (.idx) are read: start time is
+// anchored with the index entries; drop markers are read only between index entries
+// whose offsets show them (and behind the last entry), so lost frames are exact; for WAV
+// lost frames are estimated from index timing (frames recorded vs micros elapsed);
+// without sidecar only the header is used and markers are not counted ("?" in list)
+
+#include <unistd.h>
+#include <dirent.h>
+#include <limits.h>
+#include <sys/stat.h>
+
+#include <string>
+#include <vector>
+#include <atomic>
+#include <unordered_map>
+#include <random>
+
+#include "tools.h"
+#include "bin_index.h"
+#include "catalog.h"
+
+typedef struct
+{ catRecord_t rec;
+  std::string path;
+} entry_t;
+
+static c_pool pool;
+static std::mutex resLock;
+static std::vector<entry_t> found;
+static std::unordered_map<std::string, catRecord_t> known; // from existing catalog
+static std::atomic<uint32_t> nRead(0), nKept(0), nErr(0);
+
+static int64_t mtimeNs(const struct stat &st) { return (int64_t) st.st_mtim.tv_sec*1000000000 + st.st_mtim.tv_nsec; }
+
+// header and index of one file
+static void catFile(const std::string &path, const struct stat &st)
+{
+  entry_t ee;
+  ee.path = path;
+  auto it = known.find(path);
+  if(it != known.end() && it->second.size == (uint64_t) st.st_size && it->second.mtime == mtimeNs(st))
+  { ee.rec = it->second;
+    nKept++;
+  }
+  else
+  { binInfo_t info;
+    int err = hdrRead(path.c_str(), info);
+    if(err) { fprintf(stderr, "%s: %s\n", path.c_str(), hdrError(err)); nErr++; return; }
+
+    catRecord_t &rr = ee.rec;
+    memset(&rr, 0, sizeof(rr));
+    rr.size = st.st_size;
+    rr.mtime = mtimeNs(st);
+    rr.fsamp = info.fsamp;
+    rr.nch = info.nch;
+    rr.nbyte = info.nbyte;
+    rr.flags = info.wav? CAT_WAV: 0;
+    uint32_t fb = info.nch*info.nbyte;
+    uint64_t markBytes = 0;
+    rr.tstart = info.rtc;
+
+    c_binIndex bx; // private instance: load() uses a cache
+    const c_binIndex::fileIndex_t &ix = bx.load({path, (double) info.rtc});
+    if(!ix.ent.empty())
+    { rr.flags |= CAT_IDX;
+      const idxEntry_t &e0 = ix.ent[0];
+      rr.tstart = 0.5*(ix.lo+ix.hi) - (double) e0.sample/info.fsamp;
+      if(info.markSize)
+      { std::vector<binMark_t> marks;
+        c_binIndex::indexMarks(path, ix, marks);
+        rr.nmark = marks.size();
+        markBytes = rr.nmark*info.markSize;
+        for(auto &mk: marks) rr.lost += mk.rec.frames;
+      }
+      else
+        for(size_t ii=1; ii<ix.ent.size(); ii++)
+        { // WAV: drops only show as index entries later than their samples
+          double expect = (ix.dt[ii]-ix.dt[ii-1])*info.fsamp;
+          double got = ix.ent[ii].sample - ix.ent[ii-1].sample;
+          if(expect - got > 64) rr.lost += (uint32_t) (expect - got + 0.5); // > half a block
+        }
+    }
+    rr.frames = (rr.size > info.dataOffset + markBytes)? (rr.size - info.dataOffset - markBytes)/fb: 0;
+    rr.tend = rr.tstart + (double) (rr.frames + rr.lost)/info.fsamp;
+    nRead++;
+  }
+  std::lock_guard<std::mutex> lk(resLock);
+  found.push_back(ee);
+}
+
+static void catDir(const std::string &dir)
+{ DIR *dp = opendir(dir.c_str());
+  if(!dp) { perror(dir.c_str()); nErr++; return; }
+  while(struct dirent *de = readdir(dp))
+  { if(de->d_name[0]=='.') continue;
+    std::string name = dir + "/" + de->d_name;
+    size_t len = strlen(de->d_name);
+    struct stat st;
+    if(len>4 && (!strcmp(de->d_name+len-4, ".bin") || !strcmp(de->d_name+len-4, ".wav")))
+    { if(!stat(name.c_str(), &st)) pool.push([name, st] { catFile(name, st); });
+    }
+    else if(de->d_type==DT_DIR || (de->d_type==DT_UNKNOWN && !stat(name.c_str(), &st) && S_ISDIR(st.st_mode)))
+      pool.push([name] { catDir(name); });
+  }
+  closedir(dp);
+}
+
+static int update(c_catalog &cat, const char *name, char **roots, int nroots, int nthreads, int prune)
+{
+  for(auto &rr: cat.rec) known[cat.path(rr)] = rr;
+  for(int ii=0; ii<nroots; ii++)
+  { char buf[PATH_MAX];
+    if(!realpath(roots[ii], buf)) { perror(roots[ii]); return 1; }
+    std::string root = buf;
+    pool.push([root] { catDir(root); });
+  }
+  pool.run(nthreads);
+
+  // files found replace catalog entries; others are kept (other card dumps) unless gone
+  std::unordered_map<std::string, size_t> fresh;
+  for(size_t ii=0; ii<found.size(); ii++) fresh[found[ii].path] = ii;
+  uint32_t nGone = 0;
+  for(auto &kv: known)
+  { if(fresh.count(kv.first)) continue;
+    struct stat st;
+    if(prune && stat(kv.first.c_str(), &st)) { nGone++; continue; }
+    found.push_back({kv.second, kv.first});
+  }
+
+  cat.rec.clear(); cat.str.clear();
+  for(auto &ee: found)
+  { ee.rec.path = cat.str.size();
+    cat.str.insert(cat.str.end(), ee.path.c_str(), ee.path.c_str() + ee.path.size() + 1);
+    cat.rec.push_back(ee.rec);
+  }
+  if(!cat.save(name)) { perror(name); return 1; }
+  fprintf(stderr, "%s: %u files (%u read, %u unchanged, %u removed, %u errors)\n",
+    name, (uint32_t) cat.rec.size(), (uint32_t) nRead, (uint32_t) nKept, nGone, (uint32_t) nErr);
+  return nErr? 2: 0;
+}
+
+static void print(const c_catalog &cat, const catRecord_t &rr)
+{ char t0[64];
+  snprintf(t0, sizeof(t0), "%s", timeString(rr.tstart));
+  printf("%s  %s  %8.1f s  %6u Hz  %u x %u  %6u lost  %3u markers%s  %s\n", t0,
+    timeString(rr.tend)+11, rr.tend-rr.tstart, rr.fsamp, rr.nch, rr.nbyte, rr.lost, rr.nmark, (rr.flags & CAT_IDX)? "": "?", cat.path(rr));
+}
+
+int main(int argc, char *argv[])
+{
+  const char *name = "catalog.wcat";
+  int nthreads = std::thread::hardware_concurrency();
+  int prune = 0;
+  int opt;
+  while((opt = getopt(argc, argv, "c:j:p")) != -1)
+  { switch(opt)
+    { case 'c': name = optarg; break;
+      case 'j': nthreads = atoi(optarg); break;
+      case 'p': prune = 1; break;
+      default: optind = argc; break;
+    }
+  }
+  if(optind >= argc)
+  { fprintf(stderr, "usage: %s [-c catalog] [-j threads] [-p] update root ... | query t0 t1 | list | bench [n]\n", argv[0]);
+    return 1;
+  }
+  if(nthreads < 1) nthreads = 1;
+  const char *cmd = argv[optind++];
+
+  c_catalog cat;
+  int have = cat.load(name);
+  if(!strcmp(cmd, "update"))
+    return update(cat, name, argv+optind, argc-optind, nthreads, prune);
+
+  if(!have) { fprintf(stderr, "%s: no catalog\n", name); return 1; }
+  if(!strcmp(cmd, "list"))
+  { for(auto &rr: cat.rec) print(cat, rr);
+    return 0;
+  }
+  if(!strcmp(cmd, "query") && argc-optind == 2)
+  { double t0, t1;
+    if(!parseTime(argv[optind], t0) || !parseTime(argv[optind+1], t1)) { fprintf(stderr, "bad time\n"); return 1; }
+    std::vector<uint32_t> res;
+    cat.query(t0, t1, res);
+    for(uint32_t ii: res) print(cat, cat.rec[ii]);
+    return 0;
+  }
+  if(!strcmp(cmd, "bench") && !cat.rec.empty())
+  { uint32_t nq = (argc-optind > 0)? atoi(argv[optind]): 1000000;
+    double ta = cat.rec.front().tstart, tb = cat.rec.back().tend;
+    std::mt19937_64 rng(1);
+    std::uniform_real_distribution<double> uni(ta, tb);
+    std::vector<uint32_t> res;
+    uint64_t nhit = 0;
+    struct timespec t0, t1;
+    clock_gettime(CLOCK_MONOTONIC, &t0);
+    for(uint32_t ii=0; ii<nq; ii++)
+    { double tq = uni(rng);
+      cat.query(tq, tq+60, res);
+      nhit += res.size();
+    }
+    clock_gettime(CLOCK_MONOTONIC, &t1);
+    double dt = (t1.tv_sec-t0.tv_sec) + 1e-9*(t1.tv_nsec-t0.tv_nsec);
+    printf("%u files, %u queries of 60 s: %.3f us/query, %.2f files/query\n",
+      (uint32_t) cat.rec.size(), nq, 1e6*dt/nq, (double) nhit/nq);
+    return 0;
+  }
+  fprintf(stderr, "%s: unknown command or arguments\n", cmd);
+  return 1;
+}
@@ -0,0 +1,136 @@
+/* SGTL5000 Recorder for Teensy
+ * Copyright (c) 2018, Walter Zimmer
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice, development funding notice, and this permission
+ * notice shall be included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+// synthetic recording tree, e.g. for benchmarks of post-processing tools
+//
+// usage: bingen [-o dir] [-G GB] [-s MB] [-n nch] [-b nbyte] [-f fsamp] [-m markers]
+//   -o  root directory (default synth)
+//   -G  total size in GB (default 1)
+//   -s  size per file in MB (default 64)
+//   -n  channels (default 1), -b bytes per sample (default 2), -f sampling rate (default 48000)
+//   -m  drop markers per file (default 0)
+//
+// files are named as written by the recorder (DIR_yyyymmdd/hh/WMXZ_hhmmss.bin, one file
+// per t_on seconds from 2026-01-01) with version 2 header; samples carry a frame counter in
+// every channel (16 bit value, as the host HAL), counting also frames lost at drop markers
+
+#include <unistd.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <string>
+#include <vector>
+#include "../header_fmt.h"
+#include "../marker_fmt.h"
+
+int main(int argc, char *argv[])
+{
+  std::string root = "synth";
+  double gb = 1, mb = 64;
+  uint32_t nch = 1, nbyte = 2, fsamp = 48000, nmark = 0;
+  int opt;
+  while((opt = getopt(argc, argv, "o:G:s:n:b:f:m:")) != -1)
+  { switch(opt)
+    { case 'o': root = optarg; break;
+      case 'G': gb = atof(optarg); break;
+      case 's': mb = atof(optarg); break;
+      case 'n': nch = atoi(optarg); break;
+      case 'b': nbyte = atoi(optarg); break;
+      case 'f': fsamp = atoi(optarg); break;
+      case 'm': nmark = atoi(optarg); break;
+      default:
+        fprintf(stderr, "usage: %s [-o dir] [-G GB] [-s MB] [-n nch] [-b nbyte] [-f fsamp] [-m markers]\n", argv[0]);
+        return 1;
+    }
+  }
+  if(nch<1 || nch>8 || (nbyte!=2 && nbyte!=4)) { fprintf(stderr, "bad nch or nbyte\n"); return 1; }
+
+  const uint32_t fb = nch*nbyte;
+  const uint32_t blk = 32*fb;                                // frames between marker positions
+  uint64_t fileFrames = (uint64_t) (mb*(1<<20))/fb/32*32;
+  uint32_t tOn = fileFrames/fsamp + 1;
+  uint64_t nfiles = (uint64_t) (gb*1e9/(fileFrames*fb)) + 1;
+  uint32_t t0 = 1767225600; // 2026-01-01
+
+  std::vector<uint8_t> buf(1<<20);
+  uint64_t total = 0;
+  for(uint64_t ff=0; ff<nfiles; ff++)
+  { time_t tt = t0 + ff*tOn;
+    struct tm tx;
+    gmtime_r(&tt, &tx);
+    char dir[160], path[200];
+    snprintf(dir, sizeof(dir), "%s/DIR_%04d%02d%02d", root.c_str(), tx.tm_year+1900, tx.tm_mon+1, tx.tm_mday);
+    mkdir(root.c_str(), 0755); mkdir(dir, 0755);
+    snprintf(dir+strlen(dir), 40, "/%02d", tx.tm_hour);
+    mkdir(dir, 0755);
+    snprintf(path, sizeof(path), "%s/WMXZ_%02d%02d%02d.bin", dir, tx.tm_hour, tx.tm_min, tx.tm_sec);
+
+    hdr_t hh;
+    memset(&hh, 0, sizeof(hh));
+    memcpy(hh.magic, HDR_MAGIC, 4);
+    snprintf(hh.date, sizeof(hh.date), "%04u_%02u_%02u_%02u_%02u_%02u", // fields bounded to fit
+      (unsigned) (tx.tm_year+1900)%10000, (unsigned) (tx.tm_mon+1)%100, (unsigned) tx.tm_mday%100,
+      (unsigned) tx.tm_hour%100, (unsigned) tx.tm_min%100, (unsigned) tx.tm_sec%100);
+    hh.fsamp = fsamp; hh.t_on = tOn; hh.nch = nch; hh.nbyte = nbyte; hh.audio_mode = 1;
+    hh.markSize = sizeof(markRecord_t);
+    memcpy(hh.extMagic, HDR_EXT_MAGIC, 4);
+    hh.version = HDR_VERSION; hh.size = HDR_SIZE; hh.rtc = tt;
+    hh.blockSamples = 128; hh.bufferBytes = 16384;
+    hh.format.codec = HDR_CODEC_PCM; hh.format.nbyte = nbyte; hh.format.nch = nch;
+    hh.format.validBits = (nbyte==4)? 24: 16;
+    for(uint32_t ii=0; ii<nch; ii++) hh.format.chanMap[ii] = ii;
+    hh.crc = hdrCrc(&hh, offsetof(hdr_t, crc));
+
+    FILE *fd = fopen(path, "wb");
+    if(!fd) { perror(path); return 1; }
+    fwrite(&hh, 1, HDR_SIZE, fd);
+
+    uint32_t cnt = 0, nm = 0;
+    uint64_t markEvery = nmark? fileFrames/(nmark+1)/blk*blk: 0;
+    for(uint64_t fr=0; fr<fileFrames; )
+    { uint64_t nf = (fileFrames-fr < buf.size()/fb)? fileFrames-fr: buf.size()/fb;
+      if(markEvery && nm<nmark)
+      { uint64_t next = (nm+1)*markEvery;
+        if(fr == next)
+        { markRecord_t mr;
+          uint32_t lost = 128*(1+nm%5);
+          markFill(&mr, cnt/128, lost/128, lost, tt, 0);
+          fwrite(&mr, 1, sizeof(mr), fd);
+          cnt += lost; nm++;
+          total += sizeof(mr);
+        }
+        if(next > fr && next-fr < nf) nf = next-fr;
+      }
+      uint8_t *pp = buf.data();
+      for(uint64_t ii=0; ii<nf; ii++, cnt++)
+        for(uint32_t ch=0; ch<nch; ch++)
+        { if(nbyte==2) { int16_t vv = (int16_t) cnt; memcpy(pp, &vv, 2); pp += 2; }
+          else { int32_t vv = (int16_t) cnt; memcpy(pp, &vv, 4); pp += 4; }
+        }
+      fwrite(buf.data(), 1, nf*fb, fd);
+      fr += nf;
+    }
+    fclose(fd);
+    total += HDR_SIZE + fileFrames*fb;
+  }
+  fprintf(stderr, "%s: %llu files, %.2f GB\n", root.c_str(), (unsigned long long) nfiles, total*1e-9);
+  return 0;
+}
@@ -0,0 +1,105 @@
+/* SGTL5000 Recorder for Teensy
+ * Copyright (c) 2018, Walter Zimmer
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice, development funding notice, and this permission
+ * notice shall be included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+// list headers of .bin files (see bin_header.h)
+//
+// usage: binhdr [-q] [-b] path ...
+//   path  .bin/.wav file or directory (searched recursively)
+//   -q    no listing, only count and parse rate (e.g. to check a whole card)
+//   -b    list boot profiles (first file after reset or wake-up): ms per phase of setup()
+// prints one tab separated line per file, errors to stderr
+
+#include <unistd.h>
+#include <dirent.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <string>
+#include "bin_header.h"
+
+static int quiet = 0;
+static int boot = 0;
+static uint32_t nfiles = 0, nerr = 0;
+
+static void list(const std::string &path)
+{ binInfo_t info;
+  int err = hdrRead(path.c_str(), info);
+  nfiles++;
+  if(err) { nerr++; fprintf(stderr, "%s: %s\n", path.c_str(), hdrError(err)); return; }
+  if(quiet) return;
+  if(boot)
+  { const hdrBoot_t &bb = info.raw.boot;
+    if(info.version < 2 || !bb.nphase || bb.nphase > HDR_BOOT_PHASES) return;
+    printf("%s\t%s", path.c_str(), (bb.flags & HDR_BOOT_WARM)? "warm": "cold");
+    for(int ii=0; ii<bb.nphase; ii++) printf("\t%.3f", 1e-3*(bb.t[ii] - (ii? bb.t[ii-1]: 0)));
+    printf("\n");
+    return;
+  }
+  printf("%s\t%d\t%u\t%u\t%u\t%u\t%u\t%u\t%u", path.c_str(), info.version, info.rtc, info.fsamp,
+    info.nch, info.nbyte, info.format.validBits, info.markSize, info.raw.cardRate);
+  const hdrCard_t &cc = info.raw.card; // manufacturer, product name, serial number
+  if(info.version >= 2 && cc.year) printf("\t%02x:%.5s:%08x\n", cc.mid, cc.pnm, cc.psn);
+  else printf("\t-\n");
+}
+
+static void walk(const std::string &path)
+{ struct stat st;
+  if(stat(path.c_str(), &st)) { perror(path.c_str()); return; }
+  if(!S_ISDIR(st.st_mode)) { list(path); return; }
+  DIR *dp = opendir(path.c_str());
+  if(!dp) return;
+  while(struct dirent *de = readdir(dp))
+  { if(de->d_name[0]=='.') continue;
+    size_t len = strlen(de->d_name);
+    std::string name = path + "/" + de->d_name;
+    if(len>4 && (!strcmp(de->d_name+len-4, ".bin") || !strcmp(de->d_name+len-4, ".wav"))) list(name);
+    else if(de->d_type==DT_DIR || de->d_type==DT_UNKNOWN) walk(name);
+  }
+  closedir(dp);
+}
+
+int main(int argc, char *argv[])
+{
+  int opt;
+  while((opt = getopt(argc, argv, "qb")) != -1)
+  { switch(opt)
+    { case 'q': quiet = 1; break;
+      case 'b': boot = 1; break;
+      default:
+        fprintf(stderr, "usage: %s [-q] [-b] path ...\n", argv[0]);
+        return 1;
+    }
+  }
+  struct timespec t0, t1;
+  clock_gettime(CLOCK_MONOTONIC, &t0);
+  if(boot && !quiet)
+  { static const char *names[] = HDR_BOOT_NAMES;
+    printf("file\tboot");
+    for(int ii=0; ii<HDR_BOOT_PHASES; ii++) printf("\t%s", names[ii]);
+    printf("\n");
+  }
+  else if(!quiet) printf("file\tversion\trtc\tfsamp\tnch\tnbyte\tbits\tmarker\tcardRate\tcard\n");
+  for(int ii=optind; ii<argc; ii++) walk(argv[ii]);
+  clock_gettime(CLOCK_MONOTONIC, &t1);
+  double dt = (t1.tv_sec-t0.tv_sec) + 1e-9*(t1.tv_nsec-t0.tv_nsec);
+  fprintf(stderr, "%u files, %u errors, %.0f files/s\n", nfiles, nerr, dt>0? nfiles/dt: 0);
+  return nerr? 2: 0;
+}
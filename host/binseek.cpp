@@ -0,0 +1,77 @@
+/* SGTL5000 Recorder for Teensy
+ * Copyright (c) 2018, Walter Zimmer
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice, development funding notice, and this permission
+ * notice shall be included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+// time to file offset lookup in a recorder tree (see bin_index.h)
+//
+// usage: binseek [-r root] [-g] time ...
+//   -r    root of recording tree (default sdcard)
+//   -g    list drop markers of all files
+//   time  "yyyy-mm-dd hh:mm:ss[.frac]" or seconds since 1970
+// prints file, byte offset and frame number for each time
+
+#include <unistd.h>
+#include <stdlib.h>
+#include "tools.h"
+#include "bin_index.h"
+
+int main(int argc, char *argv[])
+{
+  const char *root = "sdcard";
+  int gaps = 0;
+  int opt;
+  while((opt = getopt(argc, argv, "r:g")) != -1)
+  { switch(opt)
+    { case 'r': root = optarg; break;
+      case 'g': gaps = 1; break;
+      default:
+        fprintf(stderr, "usage: %s [-r root] [-g] time ...\n", argv[0]);
+        return 1;
+    }
+  }
+
+  c_binIndex bx;
+  int nf = bx.scan(root);
+  printf("%s: %d files\n", root, nf);
+
+  if(gaps)
+  { for(auto &bf: bx.files())
+    { std::vector<binMark_t> marks;
+      c_binIndex::scanMarks(bf.path, HDR_SIZE, (uint64_t) -1, marks);
+      for(auto &mk: marks)
+        printf("%s offset %llu: %u blocks (%u frames) lost from sequence %u\n", bf.path.c_str(),
+          (unsigned long long) mk.offset, mk.rec.count, mk.rec.frames, mk.rec.seq);
+    }
+  }
+
+  for(int ii=optind; ii<argc; ii++)
+  { double t;
+    binPos_t pos;
+    if(!parseTime(argv[ii], t))
+      printf("%s: bad time\n", argv[ii]);
+    else if(!bx.lookup(t, pos))
+      printf("%s: not recorded\n", argv[ii]);
+    else
+      printf("%s: %s offset %llu frame %llu (%.6f s into file)\n", argv[ii], pos.path.c_str(),
+        (unsigned long long) pos.offset, (unsigned long long) pos.sample, t - pos.tfile);
+  }
+  return 0;
+}
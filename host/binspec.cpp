@@ -0,0 +1,378 @@
+/* SGTL5000 Recorder for Teensy
+ * Copyright (c) 2018, Walter Zimmer
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice, development funding notice, and this permission
+ * notice shall be included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+// long-term spectral average (LTSA) and spectrogram of recordings
+//
+// usage: binspec [-o outdir] [-n nfft] [-v overlap] [-a sec] [-s sec] [-d min:max] [-c ch]
+//                [-j threads] [-k MB] [-x] [-q] path ...
+//   path  .bin/.wav file or directory (searched recursively)
+//   -o    output directory, relative paths are kept (default: next to input)
+//   -n    FFT length (power of 2, default 1024), Hann window
+//   -v    overlap in percent (default 50)
+//   -a    LTSA: seconds per row (default 60), written as <name>.ltsa (spectrum.h)
+//   -s    spectrogram: seconds per column (default 0: none), written as <name>.pgm
+//   -d    dB range of spectrogram image (default -140:-40)
+//   -c    channel (default 0)
+//   -j    worker threads (default: number of hardware threads)
+//   -k    segment size in MB (default 8)
+//   -x    no SIMD (AVX2), for comparison
+//   -q    no listing, no output files (benchmark)
+//
+// each file is cut into segments of whole FFT hops; a work-stealing pool runs the
+// segments of all files. a segment streams its frames in pieces with pread, skipping
+// drop markers (lost frames are zeros, so rows keep their time), and adds its spectra
+// into the rows of the file; rows shared with a neighbour segment are added under lock.
+// the last segment of a file writes its outputs
+
+#include <unistd.h>
+#include <dirent.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <sys/stat.h>
+
+#include <string>
+#include <vector>
+#include <atomic>
+#include <mutex>
+
+#include "tools.h"
+#include "bin_index.h"
+#include "spectrum.h"
+
+static c_stealPool pool;
+
+//---------------------------------- options -------------------------------------
+static const char *outDir = 0;
+static uint32_t nfft = 1024;
+static uint32_t overlap = 50;
+static double ltsaSec = 60, specSec = 0;
+static float dbMin = -140, dbMax = -40;
+static uint32_t channel = 0;
+static uint64_t segBytes = 8<<20;
+static bool simd = true;
+static int quiet = 0;
+
+static std::atomic<uint64_t> bytesIn(0), nSpectra(0);
+static std::atomic<uint32_t> nDone(0), nErr(0), nMarks(0);
+
+//---------------------------------- analysis ------------------------------------
+typedef struct
+{ uint64_t frame;   // first frame on time line (recorded and lost frames)
+  uint64_t offset;  // in file
+  uint64_t frames;
+} run_t;
+
+typedef struct
+{ uint32_t hops;    // spectra per row
+  uint32_t nrows;
+  std::vector<float> sum;
+} rows_t;
+
+typedef struct
+{ std::string path, outPath;
+  int fd;
+  binInfo_t info;
+  double tstart;
+  uint32_t frameBytes, hop;
+  uint32_t shift;          // .bin samples are LSB aligned: full scale is 2^(validBits-1)
+  std::vector<run_t> runs;
+  uint64_t nhops;
+  rows_t ltsa, spec;
+  std::mutex lock;         // rows shared by segments
+  std::atomic<int> pending;
+} job_t;
+
+static void fail(job_t *job, const char *what)
+{ fprintf(stderr, "%s: %s%s%s\n", job->path.c_str(), what, errno? ": ": "", errno? strerror(errno): "");
+  nErr++;
+}
+
+// frames [frame, frame+n) of time line as float, lost frames as zeros
+static void readFrames(job_t *job, const c_rfft &fft, uint64_t frame, uint32_t n, float *dst)
+{ static thread_local std::vector<uint8_t> buf;
+  auto it = std::upper_bound(job->runs.begin(), job->runs.end(), frame,
+    [](uint64_t ff, const run_t &rr) { return ff < rr.frame; });
+  if(it != job->runs.begin()) --it;
+  while(n)
+  { uint32_t nz = (it == job->runs.end())? n: (frame < it->frame)? std::min<uint64_t>(n, it->frame - frame): 0;
+    if(nz) { memset(dst, 0, nz*sizeof(float)); dst += nz; frame += nz; n -= nz; continue; }
+    uint64_t skip = frame - it->frame;
+    if(skip >= it->frames) { ++it; continue; }
+    uint32_t nr = std::min<uint64_t>(n, it->frames - skip);
+    buf.resize((size_t) nr*job->frameBytes);
+    ssize_t got = pread(job->fd, buf.data(), buf.size(), it->offset + skip*job->frameBytes);
+    if(got < (ssize_t) buf.size()) { memset(dst, 0, nr*sizeof(float)); if(got < 0) got = 0; }
+    fft.convert(buf.data(), job->info.nbyte, job->info.nch, channel, got/job->frameBytes, dst);
+    bytesIn += got;
+    dst += nr; frame += nr; n -= nr;
+  }
+}
+
+// add partial sums of rows [r0, r1) to job
+static void addRows(job_t *job, rows_t &rows, const std::vector<float> &acc, uint32_t r0, uint32_t r1, uint64_t h0, uint64_t h1)
+{ uint32_t nbins = nfft/2+1;
+  for(uint32_t rr=r0; rr<r1; rr++)
+  { bool shared = (uint64_t) rr*rows.hops < h0 || std::min<uint64_t>((uint64_t) (rr+1)*rows.hops, job->nhops) > h1;
+    float *dst = &rows.sum[(size_t) rr*nbins];
+    const float *src = &acc[(size_t) (rr-r0)*nbins];
+    if(shared) job->lock.lock();
+    for(uint32_t kk=0; kk<nbins; kk++) dst[kk] += src[kk];
+    if(shared) job->lock.unlock();
+  }
+}
+
+static void finish(job_t *job);
+
+// spectra of hops [h0, h1)
+static void segment(job_t *job, uint64_t h0, uint64_t h1)
+{ static thread_local std::vector<float> in, win, wx, ps, accA, accS;
+  static thread_local c_rfft *fft = 0;
+  static thread_local uint32_t fftLen = 0;
+  if(fftLen != nfft) { delete fft; fft = new c_rfft(nfft, simd); fftLen = nfft; specHann(win, nfft, 1); }
+  wx.resize(nfft);
+
+  uint32_t nbins = nfft/2+1, hop = job->hop;
+  const uint32_t piece = 1<<16; // frames read at once
+  in.resize(piece + nfft);
+  uint32_t ra0 = h0/job->ltsa.hops, ra1 = (h1-1)/job->ltsa.hops + 1;
+  accA.assign((size_t) (ra1-ra0)*nbins, 0);
+  uint32_t rs0 = 0, rs1 = 0;
+  if(job->spec.hops)
+  { rs0 = h0/job->spec.hops; rs1 = (h1-1)/job->spec.hops + 1;
+    accS.assign((size_t) (rs1-rs0)*nbins, 0);
+  }
+
+  uint64_t pos = h0*hop, have = 0; // in[0] is frame pos, have frames valid
+  uint64_t last = (h1-1)*hop + nfft;
+  for(uint64_t hh=h0; hh<h1; hh++)
+  { uint64_t ss = hh*hop - pos;
+    if(ss + nfft > have)
+    { memmove(in.data(), in.data()+ss, (have-ss)*sizeof(float));
+      pos += ss; have -= ss; ss = 0;
+      uint32_t nn = std::min<uint64_t>(piece, last - (pos+have));
+      readFrames(job, *fft, pos+have, nn, in.data()+have);
+      have += nn;
+    }
+    fft->window(in.data()+ss, win.data(), wx.data());
+    float *acc = &accA[(size_t) (hh/job->ltsa.hops - ra0)*nbins];
+    if(job->spec.hops)
+    { float *accs = &accS[(size_t) (hh/job->spec.hops - rs0)*nbins];
+      ps.assign(nbins, 0);
+      fft->power(wx.data(), ps.data());
+      for(uint32_t kk=0; kk<nbins; kk++) { acc[kk] += ps[kk]; accs[kk] += ps[kk]; }
+    }
+    else
+      fft->power(wx.data(), acc);
+  }
+  nSpectra += h1-h0;
+  addRows(job, job->ltsa, accA, ra0, ra1, h0, h1);
+  if(job->spec.hops) addRows(job, job->spec, accS, rs0, rs1, h0, h1);
+  if(!--job->pending) finish(job);
+}
+
+// mean PSD of each row in dB
+static void rowsToDb(job_t *job, rows_t &rows)
+{ uint32_t nbins = nfft/2+1;
+  std::vector<float> ww;
+  float scale = specHann(ww, nfft, job->info.fsamp)*ldexpf(1, 2*job->shift);
+  for(uint32_t rr=0; rr<rows.nrows; rr++)
+  { uint64_t nh = std::min<uint64_t>((uint64_t) (rr+1)*rows.hops, job->nhops) - (uint64_t) rr*rows.hops;
+    float *row = &rows.sum[(size_t) rr*nbins];
+    for(uint32_t kk=0; kk<nbins; kk++)
+      row[kk] = 10*log10f(row[kk]*scale/nh + 1e-30f) - ((kk==0 || kk==nbins-1)? 3.0103f: 0);
+  }
+}
+
+static bool writeLtsa(job_t *job, const std::string &name)
+{ uint32_t nbins = nfft/2+1;
+  ltsaHeader_t hdr;
+  memset(&hdr, 0, sizeof(hdr));
+  memcpy(hdr.magic, LTSA_MAGIC, 4);
+  hdr.version = LTSA_VERSION;
+  hdr.hdrSize = sizeof(hdr);
+  hdr.nfft = nfft;
+  hdr.nbins = nbins;
+  hdr.nrows = job->ltsa.nrows;
+  hdr.fsamp = job->info.fsamp;
+  hdr.tstart = job->tstart;
+  hdr.dt = (double) job->ltsa.hops*job->hop/job->info.fsamp;
+  FILE *fd = fopen(name.c_str(), "wb");
+  if(!fd) return false;
+  bool ok = fwrite(&hdr, sizeof(hdr), 1, fd)==1
+    && fwrite(job->ltsa.sum.data(), sizeof(float), job->ltsa.sum.size(), fd)==job->ltsa.sum.size();
+  return !fclose(fd) && ok;
+}
+
+// gray image: time to the right, frequency up
+static bool writePgm(job_t *job, const std::string &name)
+{ uint32_t nbins = nfft/2+1, nrows = job->spec.nrows;
+  std::vector<uint8_t> img((size_t) nbins*nrows);
+  for(uint32_t rr=0; rr<nrows; rr++)
+    for(uint32_t kk=0; kk<nbins; kk++)
+    { float vv = (job->spec.sum[(size_t) rr*nbins + kk] - dbMin)*255/(dbMax - dbMin);
+      img[(size_t) (nbins-1-kk)*nrows + rr] = (vv < 0)? 0: (vv > 255)? 255: (uint8_t) vv;
+    }
+  FILE *fd = fopen(name.c_str(), "wb");
+  if(!fd) return false;
+  fprintf(fd, "P5\n%u %u\n255\n", nrows, nbins);
+  bool ok = fwrite(img.data(), 1, img.size(), fd)==img.size();
+  return !fclose(fd) && ok;
+}
+
+static void finish(job_t *job)
+{ close(job->fd);
+  rowsToDb(job, job->ltsa);
+  if(job->spec.hops) rowsToDb(job, job->spec);
+  if(!quiet)
+  { mkdirs(job->outPath);
+    errno = 0;
+    if(!writeLtsa(job, job->outPath + ".ltsa")) fail(job, "cannot write LTSA");
+    else if(job->spec.hops && !writePgm(job, job->outPath + ".pgm")) fail(job, "cannot write spectrogram");
+    else printf("%s -> %s.ltsa (%u rows)\n", job->path.c_str(), job->outPath.c_str(), job->ltsa.nrows);
+  }
+  nDone++;
+  delete job;
+}
+
+static void openJob(const std::string &path, const std::string &root)
+{ job_t *job = new job_t;
+  job->path = path;
+  errno = 0;
+  int err = hdrRead(path.c_str(), job->info);
+  if(err) { fprintf(stderr, "%s: %s\n", path.c_str(), hdrError(err)); nErr++; delete job; return; }
+  binInfo_t &info = job->info;
+  if((info.nbyte != 2 && info.nbyte != 4) || channel >= info.nch || !info.fsamp)
+  { fail(job, "unsupported format or channel"); delete job; return; }
+  job->fd = open(path.c_str(), O_RDONLY);
+  if(job->fd < 0) { fail(job, "cannot open"); delete job; return; }
+
+  // time line: runs of frames between drop markers, start from seek index
+  c_binIndex bx;
+  const c_binIndex::fileIndex_t &ix = bx.load({path, (double) info.rtc});
+  job->tstart = ix.ent.empty()? info.rtc: 0.5*(ix.lo+ix.hi) - (double) ix.ent[0].sample/info.fsamp;
+  job->frameBytes = info.nch*info.nbyte;
+  job->shift = (info.wav || info.format.validBits > 8*info.nbyte)? 0: 8*info.nbyte - info.format.validBits;
+  std::vector<binMark_t> marks;
+  c_binIndex::indexMarks(path, ix, marks);
+  nMarks += marks.size();
+  uint64_t off = info.dataOffset, frame = 0;
+  for(size_t ii=0; ii<=marks.size(); ii++)
+  { uint64_t end = (ii < marks.size())? marks[ii].offset: ix.size;
+    uint64_t nf = (end > off)? (end - off)/job->frameBytes: 0;
+    if(nf) job->runs.push_back({frame, off, nf});
+    frame += nf;
+    if(ii < marks.size()) { frame += marks[ii].rec.frames; off = end + marks[ii].rec.size; }
+  }
+
+  job->hop = nfft - nfft*overlap/100;
+  if(!job->hop) job->hop = 1;
+  job->nhops = (frame >= nfft)? (frame - nfft)/job->hop + 1: 0;
+  if(!job->nhops) { close(job->fd); delete job; return; }
+  uint32_t nbins = nfft/2+1;
+  auto setRows = [&](rows_t &rows, double sec)
+  { rows.hops = (sec > 0)? std::max<uint64_t>(1, (uint64_t) (sec*info.fsamp/job->hop + 0.5)): 0;
+    rows.nrows = rows.hops? (job->nhops + rows.hops - 1)/rows.hops: 0;
+    rows.sum.assign((size_t) rows.nrows*nbins, 0);
+  };
+  setRows(job->ltsa, ltsaSec);
+  setRows(job->spec, specSec);
+
+  std::string rel = path.substr(root.size() + (root.empty()? 0: 1));
+  rel = rel.substr(0, rel.size()-4);
+  job->outPath = outDir? std::string(outDir) + "/" + rel: path.substr(0, path.size()-4);
+
+  uint64_t segHops = std::max<uint64_t>(1, segBytes/job->frameBytes/job->hop);
+  job->pending = (job->nhops + segHops - 1)/segHops;
+  for(uint64_t h0=0; h0<job->nhops; h0+=segHops)
+  { uint64_t h1 = std::min(h0 + segHops, job->nhops);
+    pool.push([job, h0, h1] { segment(job, h0, h1); });
+  }
+}
+
+//---------------------------------- main ----------------------------------------
+static void walk(const std::string &path, const std::string &root)
+{ struct stat st;
+  if(stat(path.c_str(), &st)) { perror(path.c_str()); nErr++; return; }
+  if(!S_ISDIR(st.st_mode)) { pool.push([path, root] { openJob(path, root); }); return; }
+  DIR *dp = opendir(path.c_str());
+  if(!dp) return;
+  while(struct dirent *de = readdir(dp))
+  { if(de->d_name[0]=='.') continue;
+    size_t len = strlen(de->d_name);
+    std::string name = path + "/" + de->d_name;
+    if(len>4 && (!strcmp(de->d_name+len-4, ".bin") || !strcmp(de->d_name+len-4, ".wav"))) walk(name, root);
+    else if(de->d_type==DT_DIR || de->d_type==DT_UNKNOWN) walk(name, root);
+  }
+  closedir(dp);
+}
+
+int main(int argc, char *argv[])
+{
+  int nthreads = std::thread::hardware_concurrency();
+  int opt;
+  while((opt = getopt(argc, argv, "o:n:v:a:s:d:c:j:k:xq")) != -1)
+  { switch(opt)
+    { case 'o': outDir = optarg; break;
+      case 'n': nfft = atoi(optarg); break;
+      case 'v': overlap = atoi(optarg); break;
+      case 'a': ltsaSec = atof(optarg); break;
+      case 's': specSec = atof(optarg); break;
+      case 'd': sscanf(optarg, "%f:%f", &dbMin, &dbMax); break;
+      case 'c': channel = atoi(optarg); break;
+      case 'j': nthreads = atoi(optarg); break;
+      case 'k': segBytes = (uint64_t) (atof(optarg)*(1<<20)); break;
+      case 'x': simd = false; break;
+      case 'q': quiet = 1; break;
+      default:
+        fprintf(stderr, "usage: %s [-o outdir] [-n nfft] [-v overlap] [-a sec] [-s sec] [-d min:max] [-c ch]"
+                        " [-j threads] [-k MB] [-x] [-q] path ...\n", argv[0]);
+        return 1;
+    }
+  }
+  if(nfft < 16 || (nfft & (nfft-1))) { fprintf(stderr, "FFT length must be a power of 2 (>= 16)\n"); return 1; }
+  if(overlap > 95) overlap = 95;
+  if(ltsaSec <= 0) ltsaSec = 60;
+  if(dbMax <= dbMin) dbMax = dbMin + 1;
+  if(nthreads < 1) nthreads = 1;
+  if(segBytes < 1<<16) segBytes = 1<<16;
+
+  struct timespec t0, t1;
+  clock_gettime(CLOCK_MONOTONIC, &t0);
+  for(int ii=optind; ii<argc; ii++)
+  { std::string root = argv[ii];
+    while(root.size()>1 && root.back()=='/') root.pop_back();
+    struct stat st;
+    // relative output path: below directory argument, or file name only
+    std::string base = (!stat(root.c_str(), &st) && S_ISDIR(st.st_mode))? root:
+      root.substr(0, root.rfind('/')==std::string::npos? 0: root.rfind('/'));
+    walk(root, base);
+  }
+  pool.run(nthreads);
+  clock_gettime(CLOCK_MONOTONIC, &t1);
+
+  double dt = (t1.tv_sec-t0.tv_sec) + 1e-9*(t1.tv_nsec-t0.tv_nsec);
+  fprintf(stderr, "%u files, %u errors, %u drop markers, %.2f GB, %.0f k spectra, %.2f s, %.0f MB/s, %.0f k spectra/s"
+    " (%d threads, %s, %llu steals)\n", (uint32_t) nDone, (uint32_t) nErr, (uint32_t) nMarks, bytesIn*1e-9,
+    nSpectra*1e-3, dt, dt>0? bytesIn*1e-6/dt: 0, dt>0? nSpectra*1e-3/dt: 0, nthreads,
+    (simd && specHaveAVX2())? "AVX2": "scalar", (unsigned long long) pool.steals());
+  return nErr? 2: 0;
+}
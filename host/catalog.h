@@ -0,0 +1,139 @@
+/* SGTL5000 Recorder for Teensy
+ * Copyright (c) 2018, Walter Zimmer
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice, development funding notice, and this permission
+ * notice shall be included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+/*
+ * catalog of a recording tree (written by bincat), little endian
+ *
+ *   catHeader_t
+ *   catRecord_t[nrec]   sorted by tstart
+ *   char[strBytes]      0 terminated paths, referenced by catRecord_t::path
+ *
+ * a range query is a binary search for the last file starting before the end of the
+ * range, followed by a scan back over files that may still reach into the range
+ * (at most maxDuration before its begin)
+ */
+#ifndef _CATALOG_H
+#define _CATALOG_H
+
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+
+#include <string>
+#include <vector>
+#include <algorithm>
+
+#define CAT_MAGIC   "WCAT"
+#define CAT_VERSION 1
+
+#define CAT_WAV 1 // file is WAV
+#define CAT_IDX 2 // times and drops from seek index (else from header only)
+
+typedef struct
+{ char magic[4];        // CAT_MAGIC
+  uint16_t version;     // CAT_VERSION
+  uint16_t recSize;     // sizeof(catRecord_t)
+  uint32_t nrec;
+  uint32_t strBytes;
+  double maxDuration;   // longest file (s)
+} catHeader_t;
+
+typedef struct
+{ double tstart;        // first sample, seconds since 1970
+  double tend;          // behind last sample (including lost frames)
+  uint64_t frames;      // recorded frames
+  uint64_t size;        // file size (bytes), for incremental update
+  int64_t mtime;        // file modification (ns), for incremental update
+  uint32_t lost;        // frames lost (drops, from index timing)
+  uint32_t fsamp;
+  uint32_t path;        // offset into string table
+  uint16_t nch, nbyte;
+  uint16_t nmark;       // drop markers (from index offsets)
+  uint16_t flags;       // CAT_*
+  uint32_t reserved;
+} catRecord_t;
+
+static_assert(sizeof(catHeader_t) == 24, "catHeader_t must be 24 bytes");
+static_assert(sizeof(catRecord_t) == 64, "catRecord_t must be 64 bytes");
+
+class c_catalog
+{
+  public:
+    catHeader_t hdr;
+    std::vector<catRecord_t> rec;
+    std::vector<char> str;
+
+    const char *path(const catRecord_t &rr) const { return &str[rr.path]; }
+
+    // returns 0 if file is missing or no catalog
+    int load(const char *name)
+    { rec.clear(); str.clear();
+      memset(&hdr, 0, sizeof(hdr));
+      FILE *fd = fopen(name, "rb");
+      if(!fd) return 0;
+      int ok = fread(&hdr, sizeof(hdr), 1, fd)==1 && !memcmp(hdr.magic, CAT_MAGIC, 4)
+            && hdr.version==CAT_VERSION && hdr.recSize==sizeof(catRecord_t);
+      if(ok)
+      { rec.resize(hdr.nrec);
+        str.resize(hdr.strBytes);
+        ok = fread(rec.data(), sizeof(catRecord_t), hdr.nrec, fd)==hdr.nrec
+          && fread(str.data(), 1, hdr.strBytes, fd)==hdr.strBytes;
+      }
+      fclose(fd);
+      if(!ok) { rec.clear(); str.clear(); }
+      return ok;
+    }
+
+    // sorts records and writes catalog (via temporary file, so readers never see a partial one)
+    int save(const char *name)
+    { std::sort(rec.begin(), rec.end(),
+        [](const catRecord_t &a, const catRecord_t &b) { return a.tstart < b.tstart; });
+      memcpy(hdr.magic, CAT_MAGIC, 4);
+      hdr.version = CAT_VERSION;
+      hdr.recSize = sizeof(catRecord_t);
+      hdr.nrec = rec.size();
+      hdr.strBytes = str.size();
+      hdr.maxDuration = 0;
+      for(auto &rr: rec) hdr.maxDuration = std::max(hdr.maxDuration, rr.tend - rr.tstart);
+
+      std::string tmp = std::string(name) + ".tmp";
+      FILE *fd = fopen(tmp.c_str(), "wb");
+      if(!fd) return 0;
+      int ok = fwrite(&hdr, sizeof(hdr), 1, fd)==1
+        && fwrite(rec.data(), sizeof(catRecord_t), rec.size(), fd)==rec.size()
+        && fwrite(str.data(), 1, str.size(), fd)==str.size();
+      ok = !fclose(fd) && ok;
+      return ok && !rename(tmp.c_str(), name);
+    }
+
+    // indices of files with data in [t0, t1), in order of start time
+    void query(double t0, double t1, std::vector<uint32_t> &res) const
+    { res.clear();
+      auto ub = std::upper_bound(rec.begin(), rec.end(), t1,
+        [](double tt, const catRecord_t &rr) { return tt <= rr.tstart; });
+      for(long ii = (ub - rec.begin()) - 1; ii>=0 && rec[ii].tstart >= t0 - hdr.maxDuration; ii--)
+        if(rec[ii].tend > t0) res.push_back(ii);
+      std::reverse(res.begin(), res.end());
+    }
+};
+
+#endif
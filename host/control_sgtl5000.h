@@ -0,0 +1,19 @@
+// host replacement of Audio library control_sgtl5000.h (codec is not simulated)
+#ifndef control_sgtl5000_h_
+#define control_sgtl5000_h_
+
+#include "hal_host.h"
+
+#define AUDIO_INPUT_LINEIN  0
+#define AUDIO_INPUT_MIC     1
+
+class AudioControlSGTL5000
+{
+  public:
+    bool enable(void) { return true; }
+    bool disable(void) { return true; }
+    bool inputSelect(int n) { return true; }
+    bool micGain(unsigned int dB) { return true; }
+};
+
+#endif
@@ -0,0 +1,7 @@
+// host replacement of Teensy core_pins.h (see hal_host.h)
+#ifndef _CORE_PINS_H_
+#define _CORE_PINS_H_
+
+#include "hal_host.h"
+
+#endif
@@ -0,0 +1,239 @@
+/* SGTL5000 Recorder for Teensy
+ * Copyright (c) 2018, Walter Zimmer
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice, development funding notice, and this permission
+ * notice shall be included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+// implementation of the host HAL (see hal_host.h)
+
+#include <stdarg.h>
+#include <poll.h>
+#include <unistd.h>
+
+#include <chrono>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+
+#include "hal_host.h"
+#include "DMAChannel.h"
+
+using namespace std::chrono;
+
+usb_serial_class Serial;
+teensy3_clock_class Teensy3Clock;
+
+//---------------------------------- timing ---------------------------------------
+static const steady_clock::time_point t_start = steady_clock::now();
+
+uint32_t micros(void) { return duration_cast<microseconds>(steady_clock::now()-t_start).count(); }
+uint32_t millis(void) { return duration_cast<milliseconds>(steady_clock::now()-t_start).count(); }
+void delay(uint32_t msec) { std::this_thread::sleep_for(milliseconds(msec)); }
+void delayMicroseconds(uint32_t usec) { std::this_thread::sleep_for(microseconds(usec)); }
+
+//---------------------------------- RTC ------------------------------------------
+static int64_t rtc_offset = 0;
+uint32_t rtc_get(void) { return (uint32_t)(time(NULL) + rtc_offset); }
+void rtc_set(uint32_t secs) { rtc_offset = (int64_t) secs - time(NULL); }
+
+//---------------------------------- interrupts -----------------------------------
+// interrupts are modelled by a recursive lock
+// ISRs (DMA thread) hold the lock, so __disable_irq() in loop() keeps them out
+static std::recursive_mutex irq_lock;
+void hal_irq_disable(void) { irq_lock.lock(); }
+void hal_irq_enable(void) { irq_lock.unlock(); }
+
+static void (*vectors[NVIC_NUM_INTERRUPTS])(void);
+static uint8_t irq_enabled[NVIC_NUM_INTERRUPTS];
+
+void attachInterruptVector(int irq, void (*function)(void)) { vectors[irq]=function; }
+void hal_nvic_enable(int irq, int on) { irq_enabled[irq]=on; }
+
+// software interrupt: executed immediately (from within the calling ISR)
+void hal_nvic_pend(int irq)
+{ if(!irq_enabled[irq] || !vectors[irq]) return;
+  irq_lock.lock();
+  vectors[irq]();
+  irq_lock.unlock();
+}
+
+// wfi returns after next interrupt
+static std::mutex wfi_lock;
+static std::condition_variable wfi_cv;
+
+void hal_wfi(uint32_t usec)
+{ std::unique_lock<std::mutex> lk(wfi_lock);
+  wfi_cv.wait_for(lk, microseconds(usec));
+}
+
+//---------------------------------- DMA / I2S ------------------------------------
+static DMAChannel *dma_chan = 0;
+static volatile char *dma_base = 0;
+static uint32_t dma_bytes = 0;
+
+static volatile uint32_t i2s_fsamp = 44100;
+static volatile int i2s_on = 0;
+static volatile int hal_done = 0;
+static volatile uint64_t i2s_frame = 0;
+static std::thread *dma_thread = 0;
+
+void DMAChannel::enable(void)
+{ dma_base = (volatile char *) TCD->DADDR;
+  dma_bytes = TCD->BITER_ELINKNO * TCD->NBYTES_MLNO;
+  dma_chan = this;
+}
+
+// no transfer or isr of the DMA thread is in progress on return
+void DMAChannel::disable(void) { irq_lock.lock(); dma_chan = 0; irq_lock.unlock(); }
+
+/*
+ * DMA of stereo I2S (32 bit slots) into circular buffer
+ * test signal: left channel is frame counter, right channel its complement,
+ * both as 16 bit value in bits 8..23 (recorder shifts right by 8)
+ * so that gaps in recorded data are easily detected
+ */
+static void dmaThread(void)
+{
+  int half = 0;
+  steady_clock::time_point next = steady_clock::now();
+  while(!hal_done)
+  {
+    if(!i2s_on || !dma_chan || !dma_bytes)
+    { std::this_thread::sleep_for(milliseconds(1));
+      next = steady_clock::now();
+      continue;
+    }
+    uint32_t nwords = dma_bytes/2/4;
+    uint32_t nframes = nwords/2;
+    next += nanoseconds((uint64_t) nframes*1000000000ull/i2s_fsamp);
+    std::this_thread::sleep_until(next);
+
+    int32_t *dst = (int32_t *)(dma_base + half*dma_bytes/2);
+    for(uint32_t ii=0; ii<nframes; ii++)
+    { int16_t cnt = (int16_t) i2s_frame++;
+      dst[2*ii]   = ((int32_t) cnt) << 8;
+      dst[2*ii+1] = ((int32_t) (int16_t)~cnt) << 8;
+    }
+    half = 1-half;
+
+    irq_lock.lock(); // channel may have been disabled meanwhile
+    if(dma_chan)
+    { dma_chan->TCD->DADDR = (void *)(dma_base + half*dma_bytes/2); // DMA is now filling other half
+      if(dma_chan->isr) dma_chan->isr();
+    }
+    irq_lock.unlock();
+    wfi_cv.notify_all();
+  }
+}
+
+void hal_i2s_setRate(uint32_t fsamp) { i2s_fsamp = fsamp; hal_i2s_run(1); }
+
+void hal_i2s_run(int on)
+{ i2s_on = on;
+  if(on && !dma_thread) dma_thread = new std::thread(dmaThread);
+}
+
+uint64_t hal_i2s_frames(void) { return i2s_frame; }
+
+void hal_stop(void)
+{ hal_done = 1;
+  if(dma_thread) { dma_thread->join(); delete dma_thread; dma_thread=0; }
+}
+
+void hal_hibernate(uint32_t nsec)
+{ ::printf("hibernate for %u s (end of simulation)\n", nsec);
+  hal_stop();
+  fflush(stdout);
+  exit(0);
+}
+
+#define RETAIN_FILE "retain.bin"
+int hal_retain_load(uint32_t *w, int nw)
+{ FILE *fp = fopen(RETAIN_FILE, "rb");
+  if(!fp) return 0;
+  int ok = fread(w, sizeof(uint32_t), nw, fp) == (size_t) nw;
+  fclose(fp);
+  return ok;
+}
+
+void hal_retain_store(const uint32_t *w, int nw)
+{ FILE *fp = fopen(RETAIN_FILE, "wb");
+  if(!fp) return;
+  fwrite(w, sizeof(uint32_t), nw, fp);
+  fclose(fp);
+}
+
+//---------------------------------- Serial ---------------------------------------
+static int stdin_peek = -1;
+static int stdin_eof = 0;
+
+int usb_serial_class::available(void)
+{ if(stdin_peek>=0) return 1;
+  if(stdin_eof) return 0;
+  struct pollfd pfd = { 0, POLLIN, 0 };
+  if(poll(&pfd, 1, 0)<=0) return 0;
+  char c;
+  if(::read(0, &c, 1)!=1) { stdin_eof=1; return 0; }
+  stdin_peek = (unsigned char) c;
+  return 1;
+}
+
+int usb_serial_class::read(void)
+{ if(!available()) return -1;
+  int c = stdin_peek;
+  stdin_peek = -1;
+  return c;
+}
+
+int usb_serial_class::peek(void)
+{ if(!available()) return -1;
+  return stdin_peek;
+}
+
+// as Arduino Stream::parseInt: skip non-digits, read number, 1 s timeout
+long usb_serial_class::parseInt(void)
+{ uint32_t t0 = millis();
+  int c;
+  while(1)
+  { c = peek();
+    if(c<0) { if(millis()-t0 > 1000) return 0; delay(1); continue; }
+    if(c=='-' || (c>='0' && c<='9')) break;
+    read();
+  }
+  long val = 0;
+  int neg = 0;
+  while(1)
+  { if(c=='-') neg = 1;
+    else if(c>='0' && c<='9') val = 10*val + (c-'0');
+    else break;
+    read();
+    t0 = millis();
+    while((c = peek())<0 && millis()-t0 < 10) delay(1);
+    if(c<0) break;
+  }
+  return neg? -val: val;
+}
+
+int usb_serial_class::printf(const char *format, ...)
+{ va_list args;
+  va_start(args, format);
+  int ret = vprintf(format, args);
+  va_end(args);
+  return ret;
+}
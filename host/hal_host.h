@@ -0,0 +1,135 @@
+/* SGTL5000 Recorder for Teensy
+ * Copyright (c) 2018, Walter Zimmer
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice, development funding notice, and this permission
+ * notice shall be included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+/*
+ * stub hardware abstraction for host (Linux) builds
+ *
+ * replaces the parts of the Teensy core used by the recorder
+ *  - interrupts: __disable_irq/__enable_irq is a (recursive) lock,
+ *    ISRs run with the lock held
+ *  - NVIC: software interrupts run immediately when set pending
+ *  - DMA: a thread fills the circular I2S buffer in real time and calls the
+ *    half/full buffer interrupt (see DMAChannel.h)
+ *  - Serial: stdout/stdin
+ *  - RTC: host clock (optionally shifted to a given start time)
+ */
+
+#ifndef _HAL_HOST_H
+#define _HAL_HOST_H
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#ifndef F_CPU
+  #define F_CPU 600000000
+#endif
+#define F_CPU_ACTUAL F_CPU
+
+#define DMAMEM
+#define FLASHMEM
+#define FASTRUN
+
+// timing
+uint32_t millis(void);
+uint32_t micros(void);
+void delay(uint32_t msec);
+void delayMicroseconds(uint32_t usec);
+static inline void yield(void) { }
+
+// interrupts
+void hal_irq_disable(void);
+void hal_irq_enable(void);
+#define __disable_irq() hal_irq_disable()
+#define __enable_irq() hal_irq_enable()
+
+#define IRQ_SOFTWARE 70
+#define NVIC_NUM_INTERRUPTS 160
+
+void attachInterruptVector(int irq, void (*function)(void));
+void hal_nvic_enable(int irq, int on);
+void hal_nvic_pend(int irq);
+#define NVIC_ENABLE_IRQ(n) hal_nvic_enable(n,1)
+#define NVIC_DISABLE_IRQ(n) hal_nvic_enable(n,0)
+#define NVIC_SET_PENDING(n) hal_nvic_pend(n)
+#define NVIC_CLEAR_PENDING(n)
+#define NVIC_SET_PRIORITY(n,p)
+
+// wait for interrupt (or timeout in us)
+void hal_wfi(uint32_t usec=1000);
+
+// simulated I2S (sampling frequency and clock on/off)
+void hal_i2s_setRate(uint32_t fsamp);
+void hal_i2s_run(int on);
+uint64_t hal_i2s_frames(void); // frames generated since start
+
+// RTC
+uint32_t rtc_get(void);
+void rtc_set(uint32_t secs);
+class teensy3_clock_class
+{
+  public:
+    static unsigned long get(void) { return rtc_get(); }
+    static void set(unsigned long t) { rtc_set(t); }
+};
+extern teensy3_clock_class Teensy3Clock;
+
+// hibernate: stops simulation
+void hal_hibernate(uint32_t nsec);
+void hal_stop(void);
+
+// state retained across hibernation (retain.h), kept in file retain.bin between runs
+int hal_retain_load(uint32_t *w, int nw);
+void hal_retain_store(const uint32_t *w, int nw);
+
+// serial over stdin/stdout
+class usb_serial_class
+{
+  public:
+    operator bool() { return true; }
+    int available(void);
+    int read(void);
+    int peek(void);
+    long parseInt(void);
+    void flush(void) { fflush(stdout); }
+
+    int printf(const char *format, ...) __attribute__((format(printf,2,3)));
+
+    size_t print(const char *s) { return fputs(s,stdout)>=0? strlen(s): 0; }
+    size_t print(char c) { return fputc(c,stdout)!=EOF; }
+    size_t print(int n) { return ::printf("%d",n); }
+    size_t print(unsigned int n) { return ::printf("%u",n); }
+    size_t print(long n) { return ::printf("%ld",n); }
+    size_t print(unsigned long n) { return ::printf("%lu",n); }
+    size_t print(long long n) { return ::printf("%lld",n); }
+    size_t print(unsigned long long n) { return ::printf("%llu",n); }
+    size_t print(double n, int digits=2) { return ::printf("%.*f",digits,n); }
+
+    size_t println(void) { return print('\n'); }
+    template <typename T> size_t println(T val) { size_t n=print(val); return n+println(); }
+    size_t println(double val, int digits) { size_t n=print(val,digits); return n+println(); }
+};
+extern usb_serial_class Serial;
+
+#endif
@@ -0,0 +1,57 @@
+/* SGTL5000 Recorder for Teensy
+ * Copyright (c) 2018, Walter Zimmer
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice, development funding notice, and this permission
+ * notice shall be included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+// host main: runs setup() and loop() of main.cpp like the Teensy core would
+//
+// usage: record_sgtl5000 [-t seconds] [-s rtc_start]
+//   -t  duration of simulation (default 10 s)
+//   -s  RTC start time (seconds since 1970), e.g. to start within recording period
+
+#include <unistd.h>
+#include "hal_host.h"
+
+extern "C" void setup(void);
+void loop(void);
+void host_shutdown(void);
+
+int main(int argc, char *argv[])
+{
+  uint32_t duration = 10;
+  int opt;
+  while((opt = getopt(argc, argv, "t:s:")) != -1)
+  { switch(opt)
+    { case 't': duration = atoi(optarg); break;
+      case 's': rtc_set(strtoul(optarg, 0, 0)); break;
+      default:
+        fprintf(stderr, "usage: %s [-t seconds] [-s rtc_start]\n", argv[0]);
+        return 1;
+    }
+  }
+
+  setup();
+  uint32_t t0 = millis();
+  while(millis()-t0 < 1000*duration) loop();
+
+  host_shutdown();
+  hal_stop();
+  return 0;
+}
@@ -0,0 +1,162 @@
+/* SGTL5000 Recorder for Teensy
+ * Copyright (c) 2018, Walter Zimmer
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice, development funding notice, and this permission
+ * notice shall be included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+// check of a host recording (make test): test signal must be gap free within and across files
+//
+// usage: rectest [-n files] root
+//   root  recording tree written by bin/record_sgtl5000 (e.g. sdcard)
+//   -n    minimum number of files (default 2: at least one rotation)
+//
+// the host HAL records a frame counter (hal_host.cpp): channel 0 is the counter, channel 1
+// its complement, 16 bit. Every file of the run must
+//   - have a valid header and a size of whole frames (truncated at close, not preallocated)
+//   - have an index sidecar (.bin) whose entries point to their frames and whose RTC seconds
+//     agree with their micros() (stamped frame lies in [rtc, rtc+1), up to RTC_SLACK)
+//   - continue the counter of the previous file without loss or repetition
+// returns 0 if all files pass
+
+#include <unistd.h>
+#include <dirent.h>
+#include <sys/stat.h>
+#include <string>
+#include <vector>
+#include <algorithm>
+
+#include "bin_header.h"
+#include "../index_fmt.h"
+
+#define RTC_SLACK 0.01 // s: RTC second edge is seen by loop() with this delay at most
+
+static std::vector<std::string> files;
+static int nerr = 0;
+
+static void walk(const std::string &path)
+{ DIR *dp = opendir(path.c_str());
+  if(!dp) return;
+  while(struct dirent *de = readdir(dp))
+  { if(de->d_name[0]=='.') continue;
+    std::string name = path + "/" + de->d_name;
+    size_t len = strlen(de->d_name);
+    struct stat st;
+    if(len>4 && (!strcmp(de->d_name+len-4, ".bin") || !strcmp(de->d_name+len-4, ".wav"))) files.push_back(name);
+    else if(!stat(name.c_str(), &st) && S_ISDIR(st.st_mode)) walk(name);
+  }
+  closedir(dp);
+}
+
+static void fail(const std::string &path, const char *msg, long long val=-1)
+{ if(val>=0) fprintf(stderr, "%s: %s (%lld)\n", path.c_str(), msg, val);
+  else fprintf(stderr, "%s: %s\n", path.c_str(), msg);
+  nerr++;
+}
+
+static int readFile(const std::string &path, std::vector<uint8_t> &buf)
+{ FILE *fp = fopen(path.c_str(), "rb");
+  if(!fp) return 0;
+  fseek(fp, 0, SEEK_END);
+  buf.resize(ftell(fp));
+  fseek(fp, 0, SEEK_SET);
+  size_t nn = fread(buf.data(), 1, buf.size(), fp);
+  fclose(fp);
+  return nn == buf.size();
+}
+
+// 16 bit counter of channel ch in frame
+static uint16_t counter(const uint8_t *frame, const binInfo_t &info, int ch)
+{ if(info.nbyte==2) { int16_t ss; memcpy(&ss, frame+2*ch, 2); return ss; }
+  int32_t ss; memcpy(&ss, frame+4*ch, 4);
+  if(info.wav) ss >>= 32-info.format.validBits; // MSB aligned
+  return ss;
+}
+
+static void checkIndex(const std::string &path, const binInfo_t &info, uint64_t size)
+{ std::string name = path.substr(0, path.size()-4) + ".idx";
+  std::vector<uint8_t> buf;
+  if(!readFile(name, buf) || buf.size() < sizeof(idxHeader_t)) { fail(path, "no index sidecar"); return; }
+  idxHeader_t hh;
+  memcpy(&hh, buf.data(), sizeof(hh));
+  if(memcmp(hh.magic, IDX_MAGIC, 4) || hh.entrySize != sizeof(idxEntry_t) || hh.nch != info.nch || hh.nbyte != info.nbyte)
+  { fail(name, "bad index header"); return; }
+  uint32_t nent = (buf.size() - sizeof(hh))/sizeof(idxEntry_t);
+  if(!nent) { fail(name, "empty index"); return; }
+  uint32_t fb = info.nch*info.nbyte;
+  idxEntry_t e0;
+  memcpy(&e0, buf.data() + sizeof(hh), sizeof(e0));
+  double lo = -1e9, hi = 1e9; // sub-second anchor: all entries must see the same RTC second edge
+  for(uint32_t ii=0; ii<nent; ii++)
+  { idxEntry_t ee;
+    memcpy(&ee, buf.data() + sizeof(hh) + ii*sizeof(ee), sizeof(ee));
+    if(ee.offset >= size || ee.sample != (ee.offset - info.dataOffset)/fb) { fail(name, "entry does not point to its frame", ii); return; }
+    double dt = 1e-6*(int32_t) (ee.usec - e0.usec) - ((double) ee.rtc - (double) e0.rtc);
+    lo = std::max(lo, -dt);
+    hi = std::min(hi, 1.0 - dt);
+    if(lo > hi + RTC_SLACK) { fail(name, "entry rtc does not match its usec", ii); return; }
+  }
+}
+
+int main(int argc, char *argv[])
+{
+  uint32_t nmin = 2;
+  int opt;
+  while((opt = getopt(argc, argv, "n:")) != -1)
+  { switch(opt)
+    { case 'n': nmin = atoi(optarg); break;
+      default: optind = argc; break;
+    }
+  }
+  if(optind != argc-1) { fprintf(stderr, "usage: %s [-n files] root\n", argv[0]); return 1; }
+  walk(argv[optind]);
+  std::sort(files.begin(), files.end()); // DIR_yyyymmdd/hh/WMXZ_hhmmss: in time order
+  if(files.size() < nmin) { fprintf(stderr, "%s: %zu files, expected at least %u\n", argv[optind], files.size(), nmin); return 2; }
+
+  uint64_t nframes = 0;
+  int haveLast = 0;
+  uint16_t last = 0;
+  for(auto &path: files)
+  { binInfo_t info;
+    int err = hdrRead(path.c_str(), info);
+    if(err) { fail(path, hdrError(err)); haveLast = 0; continue; }
+    std::vector<uint8_t> buf;
+    if(!readFile(path, buf)) { fail(path, "read error"); continue; }
+    uint32_t fb = info.nch*info.nbyte;
+    if(buf.size() <= info.dataOffset) { fail(path, "no data"); continue; }
+    uint64_t nbytes = buf.size() - info.dataOffset;
+    if(nbytes % fb) fail(path, "size is not whole frames", nbytes % fb);
+    if(!info.wav) checkIndex(path, info, buf.size());
+
+    const uint8_t *data = buf.data() + info.dataOffset;
+    uint64_t nn = nbytes/fb;
+    for(uint64_t ii=0; ii<nn; ii++)
+    { uint16_t cc = counter(data + ii*fb, info, 0);
+      if(info.nch>1 && counter(data + ii*fb, info, 1) != (uint16_t) ~cc) { fail(path, "channels out of step at frame", ii); break; }
+      if(haveLast && cc != (uint16_t) (last+1))
+      { fail(path, ii? "counter gap at frame": "counter gap to previous file", ii);
+        break;
+      }
+      last = cc;
+      haveLast = 1;
+    }
+    nframes += nn;
+  }
+  printf("%zu files, %llu frames, %d errors\n", files.size(), (unsigned long long) nframes, nerr);
+  return nerr? 2: 0;
+}
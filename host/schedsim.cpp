@@ -0,0 +1,224 @@
+/* SGTL5000 Recorder for Teensy
+ * Copyright (c) 2018, Walter Zimmer
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice, development funding notice, and this permission
+ * notice shall be included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+// projection of a deployment: runs the recorder schedule (schedule.h, as main.cpp)
+// against a simulated clock, one step per file end or hibernation
+//
+// usage: schedsim [options]
+//   -p periods  daily record periods in hours, e.g. 8-12,12-22 (default r_hours)
+//   -a sec      a_on, -A sec a_off, -t sec t_on (defaults from config.h)
+//   -f fsamp    sampling rate (default fsamps[FSI]), -n nch, -b nbyte (default NCH, NBYTE)
+//   -w          WAV output (OUT_WAV: 1024 byte header), default as OUT_FORMAT
+//   -s time     start, "yyyy-mm-dd hh:mm:ss" or seconds since 1970 (default 2026-01-01)
+//   -d days     simulated time (default 365)
+//   -B sec      boot time from wake-up to recording (default 1)
+//   -I r:h:b    current in mA while recording, hibernating, booting (default 60:0.2:40)
+//   -V volt     battery voltage (default 3.7)
+//   -C mAh      battery capacity: days until empty (default 0: not reported)
+//   -G GB       card capacity: days until full (default 0: not reported)
+//   -k kB       cluster size, files occupy whole clusters (default 32, exFAT above 32 GB: 128)
+//
+// firmware behaviour modelled: at each wake-up (reset) setup() asks the schedule;
+// outside the record time it hibernates for the returned seconds, else it records
+// and loop() closes the file at -1 (new file) or >0 (hibernate). a file holds the
+// frames between its open and close time, plus header and .idx sidecar
+
+#include <unistd.h>
+#include <stdint.h>
+#include <string.h>
+#include <math.h>
+#include <vector>
+
+#include "config.h"
+#include "../schedule.h"
+#include "../index_fmt.h"
+#include "tools.h"
+
+typedef struct
+{ uint64_t files, dataBytes, hdrBytes, idxBytes;
+  uint64_t diskBytes;                 // in whole clusters
+  uint64_t wakes, hibernates;
+  double tRec, tHib, tBoot;           // seconds in state
+  double hibMin, hibMax;
+  double cardFull, batteryEmpty;      // day of simulation (0: not reached)
+} simResult_t;
+
+static bool parsePeriods(const char *str, std::vector<uint16_t> &hh)
+{ hh.clear();
+  while(*str)
+  { unsigned h0, h1;
+    int nn;
+    if(sscanf(str, "%u-%u%n", &h0, &h1, &nn) != 2 || h0 > 24 || h1 > 24) return false;
+    hh.push_back(h0); hh.push_back(h1);
+    str += nn;
+    if(*str == ',') str++;
+  }
+  return hh.size()/2 <= SCHED_MAX_PERIODS;
+}
+
+int main(int argc, char *argv[])
+{
+  std::vector<uint16_t> hours;
+  for(uint32_t ii=0; ii<R_NPER; ii++) { hours.push_back(r_hours[ii][0]); hours.push_back(r_hours[ii][1]); }
+  uint32_t aOn = a_on, aOff = a_off, tOn = t_on;
+  uint32_t fsamp = fsamps[FSI], nch = NCH, nbyte = NBYTE;
+  uint32_t hdrBytes = FILE_HDR_BYTES;
+  double tStart = 1767225600; // 2026-01-01
+  double days = 365, tBootSec = 1;
+  double iRec = 60, iHib = 0.2, iBoot = 40, volt = 3.7, capacity = 0, cardGB = 0;
+  uint64_t cluster = 32*1024;
+
+  int opt;
+  while((opt = getopt(argc, argv, "p:a:A:t:f:n:b:ws:d:B:I:V:C:G:k:")) != -1)
+  { switch(opt)
+    { case 'p': if(!parsePeriods(optarg, hours)) { fprintf(stderr, "bad periods: %s\n", optarg); return 1; } break;
+      case 'a': aOn = atoi(optarg); break;
+      case 'A': aOff = atoi(optarg); break;
+      case 't': tOn = atoi(optarg); break;
+      case 'f': fsamp = atoi(optarg); break;
+      case 'n': nch = atoi(optarg); break;
+      case 'b': nbyte = atoi(optarg); break;
+      case 'w': hdrBytes = 1024; break;
+      case 's': if(!parseTime(optarg, tStart)) { fprintf(stderr, "bad time: %s\n", optarg); return 1; } break;
+      case 'd': days = atof(optarg); break;
+      case 'B': tBootSec = atof(optarg); break;
+      case 'I': sscanf(optarg, "%lf:%lf:%lf", &iRec, &iHib, &iBoot); break;
+      case 'V': volt = atof(optarg); break;
+      case 'C': capacity = atof(optarg); break;
+      case 'G': cardGB = atof(optarg); break;
+      case 'k': cluster = (uint64_t) (atof(optarg)*1024); break;
+      default:
+        fprintf(stderr, "usage: %s [-p periods] [-a a_on] [-A a_off] [-t t_on] [-f fsamp] [-n nch] [-b nbyte] [-w]"
+                        " [-s start] [-d days] [-B boot] [-I rec:hib:boot] [-V volt] [-C mAh] [-G GB] [-k kB]\n", argv[0]);
+        return 1;
+    }
+  }
+  if(cluster < 512) cluster = 512;
+  if(!aOn || !tOn || !fsamp) { fprintf(stderr, "a_on, t_on and fsamp must not be 0\n"); return 1; }
+
+  c_schedule sched;
+  sched.begin((const uint16_t (*)[2]) hours.data(), hours.size()/2, aOn, aOff, tOn);
+
+  uint32_t t0 = (uint32_t) tStart, tEnd = (uint32_t) (tStart + days*86400);
+  uint64_t frameBytes = nch*nbyte;
+  uint64_t bufBytes = (uint64_t) BUFFERSIZE*NBYTE;
+  double cardBytes = cardGB*1e9, charge = 0; // mAs
+  simResult_t res;
+  memset(&res, 0, sizeof(res));
+  res.hibMin = 1e30;
+
+  struct timespec c0, c1;
+  clock_gettime(CLOCK_MONOTONIC, &c0);
+
+  // states of the clock: wake-up (reset), recording a file, hibernating
+  double tt = t0;
+  bool booting = true;
+  uint32_t tOpen = 0;
+  while(tt < tEnd)
+  { if(booting)
+    { res.wakes++;
+      double tb = std::min<double>(tBootSec, tEnd - tt);
+      res.tBoot += tb; charge += tb*iBoot;
+      tt += tb;
+      booting = false;
+      sched.reset();
+      uint32_t now = (uint32_t) tt;
+      int32_t ret = sched.check(now);
+      if(ret > 0) // setup(): hibernate right away
+      { double th = std::min<double>(ret, tEnd - tt);
+        res.hibernates++; res.tHib += th; charge += th*iHib;
+        res.hibMin = std::min<double>(res.hibMin, ret); res.hibMax = std::max<double>(res.hibMax, ret);
+        tt = now + ret;
+        booting = true;
+        continue;
+      }
+      tOpen = now;
+      continue;
+    }
+
+    // recording: nothing happens before the next deadline of the schedule
+    uint32_t tn = sched.next();
+    if(tn > tEnd) tn = tEnd;
+    double tr = tn - tt;
+    res.tRec += tr; charge += tr*iRec;
+    tt = tn;
+    int32_t ret = (tn < tEnd)? sched.check(tn): 1;
+
+    // file closed at tn (end of file or of recording)
+    uint64_t bytes = (uint64_t) (tn - tOpen)*fsamp*frameBytes;
+    uint64_t nbuf = (bytes + bufBytes - 1)/bufBytes;
+    uint64_t nidx = IDX_EVERY? std::min<uint64_t>(nbuf/IDX_EVERY + 1, IDX_MAX): 0;
+    res.files++;
+    res.dataBytes += bytes;
+    res.hdrBytes += hdrBytes;
+    uint64_t ibytes = nidx? sizeof(idxHeader_t) + nidx*sizeof(idxEntry_t): 0;
+    res.idxBytes += ibytes;
+    res.diskBytes += (hdrBytes + bytes + cluster - 1)/cluster*cluster + (ibytes + cluster - 1)/cluster*cluster;
+    double used = res.diskBytes;
+    if(cardBytes > 0 && !res.cardFull && used >= cardBytes) res.cardFull = (tt - t0)/86400;
+    if(capacity > 0 && !res.batteryEmpty && charge/3600 >= capacity) res.batteryEmpty = (tt - t0)/86400;
+    tOpen = tn;
+
+    if(ret > 0 && tn < tEnd) // stopAcq(): hibernate, reset at wake-up
+    { double th = std::min<double>(ret, tEnd - tt);
+      res.hibernates++; res.tHib += th; charge += th*iHib;
+      res.hibMin = std::min<double>(res.hibMin, ret); res.hibMax = std::max<double>(res.hibMax, ret);
+      tt = tn + (double) ret;
+      booting = true;
+    }
+  }
+  clock_gettime(CLOCK_MONOTONIC, &c1);
+  double dt = (c1.tv_sec-c0.tv_sec) + 1e-9*(c1.tv_nsec-c0.tv_nsec);
+
+  printf("schedule: periods");
+  for(size_t ii=0; ii<hours.size(); ii+=2) printf(" %u-%u", hours[ii], hours[ii+1]);
+  if(hours.empty()) printf(" (whole day)");
+  printf(", a_on %u s, a_off %u s, t_on %u s\n", aOn, aOff, tOn);
+  printf("format:   %u Hz, %u x %u bytes, %s (%u byte header)\n", fsamp, nch, nbyte, (hdrBytes==1024)? "wav": "bin", hdrBytes);
+  printf("time:     %s + %.1f days (simulated in %.1f ms)\n\n", timeString(t0), days, 1e3*dt);
+
+  double total = tEnd - t0;
+  printf("files        %12llu  (%.1f per day)\n", (unsigned long long) res.files, res.files*86400/total);
+  printf("data         %12.3f GB (%.2f GB per day)\n", res.dataBytes*1e-9, res.dataBytes*1e-9*86400/total);
+  printf("headers      %12.3f GB\n", res.hdrBytes*1e-9);
+  printf("index        %12.3f GB\n", res.idxBytes*1e-9);
+  printf("on card      %12.3f GB (%llu kB clusters)\n", res.diskBytes*1e-9, (unsigned long long) cluster/1024);
+  printf("wake-ups     %12llu\n", (unsigned long long) res.wakes);
+  printf("hibernations %12llu  (%.0f .. %.0f s)\n", (unsigned long long) res.hibernates,
+    res.hibernates? res.hibMin: 0, res.hibMax);
+  printf("\n%-10s %10s %8s %10s %10s\n", "state", "hours", "%", "mA", "mAh");
+  printf("%-10s %10.1f %8.2f %10.3f %10.1f\n", "record", res.tRec/3600, 100*res.tRec/total, iRec, res.tRec*iRec/3600);
+  printf("%-10s %10.1f %8.2f %10.3f %10.1f\n", "hibernate", res.tHib/3600, 100*res.tHib/total, iHib, res.tHib*iHib/3600);
+  printf("%-10s %10.1f %8.2f %10.3f %10.1f\n", "boot", res.tBoot/3600, 100*res.tBoot/total, iBoot, res.tBoot*iBoot/3600);
+  printf("%-10s %10.1f %8s %10.3f %10.1f  (%.1f Wh at %.1f V)\n", "total", total/3600, "",
+    charge/total, charge/3600, charge/3600*volt*1e-3, volt);
+  if(capacity > 0)
+  { if(res.batteryEmpty) printf("battery of %.0f mAh empty after %.1f days\n", capacity, res.batteryEmpty);
+    else printf("battery of %.0f mAh lasts %.1f days\n", capacity, capacity*3600/(charge/total)/86400);
+  }
+  if(cardGB > 0)
+  { double perDay = res.diskBytes*86400/total;
+    if(res.cardFull) printf("card of %.0f GB full after %.1f days\n", cardGB, res.cardFull);
+    else printf("card of %.0f GB full after %.1f days\n", cardGB, perDay>0? cardBytes/perDay: 0);
+  }
+  return 0;
+}
@@ -0,0 +1,287 @@
+/* SGTL5000 Recorder for Teensy
+ * Copyright (c) 2018, Walter Zimmer
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice, development funding notice, and this permission
+ * notice shall be included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+// sizing of acquisition queue (MQUEU) and disk buffers (BUFFERSIZE)
+//
+// discrete event simulation of the recorder pipeline:
+//   I2S delivers one block per channel every AUDIO_BLOCK_SAMPLES_NCH/fsamp
+//   loop() moves blocks from queue into disk buffer as long as a disk buffer is free
+//   c_uSD writes full disk buffers in WRITE_CHUNK pieces, each keeping the card
+//   busy as given by the latency model (c_latency, fs_if.h) or a recorded trace
+// the largest queue fill seen gives the minimum MQUEU for zero drops
+// the pool holds the queues of all channels (NPOOL = NCH*MQUEU+6); sizes are generated
+// for every combination of the given channels and word sizes
+//
+// usage: sizing [options]
+//   -n nch,..   channels (default NCH)
+//   -b nbyte,.. bytes per sample (default NBYTE)
+//   -k ndbuf    number of disk buffers (default NDBUF)
+//   -c chunk    bytes per card write (default 4096, as WRITE_CHUNK)
+//   -d sec      simulated time per case (default 600)
+//   -l us       base latency per write (default SIM_WRITE_LATENCY)
+//   -r rate     bytes per us (default SIM_WRITE_RATE)
+//   -p prob     stall probability per write in 1/65536 (default 16)
+//   -T us       stall duration (default SIM_STALL_TIME)
+//   -t file     replay busy times from trace (one value in us per write, last column)
+//   -m percent  safety margin on MQUEU (default 25)
+//   -o file     write generated header (e.g. ../sizing.h)
+
+#include <unistd.h>
+#include <vector>
+
+#include "hal_host.h"
+#include "config.h"
+#include "mAudioStream.h"
+#include "fs_if.h"
+
+static const uint32_t bufSizes[] = {2048, 4096, 8192, 16384, 32768}; // BUFFERSIZE candidates (words)
+#define NBUFSIZES (sizeof(bufSizes)/sizeof(bufSizes[0]))
+#define NFSAMPS (sizeof(fsamps)/sizeof(fsamps[0]))
+
+typedef struct
+{ uint32_t maxQueue;  // largest number of blocks waiting in queue
+  uint32_t drops;     // blocks dropped for given queue size
+  uint32_t maxBusy;   // longest card busy time (us)
+} simResult_t;
+
+static int nch = NCH;
+static int nbyte = NBYTE;
+static std::vector<int> nchList = {NCH};
+static std::vector<int> nbyteList = {NBYTE};
+static int ndbuf = NDBUF;
+static uint32_t chunk = 4096;
+
+static simResult_t simulate(uint32_t fsamp, uint32_t mqueu, uint32_t bufsize, double duration, c_latency &lat)
+{
+  uint32_t nsamp = AUDIO_BLOCK_SAMPLES*nch;        // samples per channel and block
+  uint32_t blkBytes = nch*nsamp*nbyte;             // bytes per block (all channels)
+  uint32_t bufBytes = bufsize*nbyte;
+  double tBlk = 1e6*nsamp/fsamp;                   // us
+  uint64_t nblocks = (uint64_t) (duration*fsamp/nsamp);
+
+  std::vector<double> tPend(ndbuf);                // time buffer was handed to writer
+  uint32_t head=0, npend=0, woff=0, fill=0, q=0;
+  double tCard = 0;                                // card is free again
+  simResult_t res = {0, 0, 0};
+
+  lat.reset();
+
+  auto drain = [&](double t)
+  { while(q>0 && (int) npend<ndbuf)
+    { q--;
+      fill += blkBytes;
+      if(fill >= bufBytes)
+      { fill -= bufBytes;
+        tPend[(head+npend) % ndbuf] = t;
+        npend++;
+      }
+    }
+  };
+
+  for(uint64_t kk=0; kk<nblocks; kk++)
+  { double t = kk*tBlk;
+
+    // writer: chunks that start before this block arrives
+    while(npend)
+    { double t0 = (tCard > tPend[head])? tCard: tPend[head];
+      if(t0 > t) break;
+      uint32_t nb = bufBytes-woff;
+      if(nb > chunk) nb = chunk;
+      tCard = t0 + lat.busyTime(nb);
+      woff += nb;
+      if(woff == bufBytes)
+      { woff=0; npend--; head = (head+1) % ndbuf;
+        drain(tCard);
+      }
+    }
+
+    q++;
+    if(q > res.maxQueue) res.maxQueue = q;
+    if(q > mqueu-1) { q--; res.drops++; } // ring buffer holds mqueu-1 blocks
+    drain(t);
+  }
+  res.maxBusy = lat.maxBusy;
+  return res;
+}
+
+static std::vector<int> parseList(const char *arg)
+{ std::vector<int> ll;
+  for(const char *cp = arg; *cp; )
+  { char *end;
+    int val = strtol(cp, &end, 10);
+    if(end==cp || val<=0) { fprintf(stderr, "bad list: %s\n", arg); exit(1); }
+    ll.push_back(val);
+    cp = (*end==',')? end+1: end;
+  }
+  return ll;
+}
+
+typedef struct
+{ int nch, nbyte;
+  uint32_t mqueu[NFSAMPS], npool[NFSAMPS], bufsize[NFSAMPS];
+} sizing_t;
+
+// best queue and buffer size (least RAM) per fsamp for current nch/nbyte
+static sizing_t sizeFor(double duration, int margin, c_latency &lat)
+{ sizing_t sz;
+  sz.nch = nch; sz.nbyte = nbyte;
+  int current = (nch==NCH) && (nbyte==NBYTE);
+
+  printf("NCH %d, NBYTE %d\n", nch, nbyte);
+  printf("%8s", "fsamp");
+  for(uint32_t jj=0; jj<NBUFSIZES; jj++) printf(" %7u", bufSizes[jj]);
+  printf(" | %6s %8s %6s %8s | %s\n", "MQUEU", "BUFSIZE", "pool", "RAM kB", "drops (current)");
+
+  uint32_t nsamp = AUDIO_BLOCK_SAMPLES*nch;
+  for(uint32_t ii=0; ii<NFSAMPS; ii++)
+  { uint32_t fs = fsamps[ii];
+    uint32_t ram = 0xffffffff;
+    uint64_t nblocks = (uint64_t) (duration*fs/nsamp);
+    sz.mqueu[ii] = sz.npool[ii] = 0; sz.bufsize[ii] = bufSizes[0]; // 0: card too slow, no size
+    printf("%8u", fs);
+    for(uint32_t jj=0; jj<NBUFSIZES; jj++)
+    { simResult_t res = simulate(fs, 0xffffffff, bufSizes[jj], duration, lat);
+      printf(" %7u", res.maxQueue);
+      if(res.maxQueue > nblocks/10) continue; // queue grows without bound
+      uint32_t mq = (res.maxQueue+1) + ((res.maxQueue+1)*margin + 99)/100;
+      uint32_t pool = nch*mq + 6;                   // blocks in all queues + I2S and loop()
+      uint32_t bytes = pool*nsamp*nbyte + ndbuf*bufSizes[jj]*nbyte;
+      if(bytes < ram) { ram=bytes; sz.mqueu[ii]=mq; sz.npool[ii]=pool; sz.bufsize[ii]=bufSizes[jj]; }
+    }
+    if(sz.mqueu[ii]) printf(" | %6u %8u %6u %8.1f | ", sz.mqueu[ii], sz.bufsize[ii], sz.npool[ii], ram/1024.0);
+    else printf(" | %6s %8s %6s %8s | ", "-", "-", "-", "overrun");
+    if(current) printf("%u\n", simulate(fs, MQUEU, BUFFERSIZE, duration, lat).drops); else printf("-\n");
+  }
+  printf("\n");
+  return sz;
+}
+
+static void writeTable(FILE *fd, const char *name, const uint32_t *val)
+{ fprintf(fd, "  constexpr uint32_t %s[SIZING_NFS] = {", name);
+  for(uint32_t ii=0; ii<NFSAMPS; ii++) fprintf(fd, "%s%u", ii? ", ": "", val[ii]);
+  fprintf(fd, "};\n");
+}
+
+static std::vector<uint32_t> readTrace(const char *name)
+{ std::vector<uint32_t> tr;
+  FILE *fd = fopen(name, "r");
+  if(!fd) { perror(name); exit(1); }
+  char line[256];
+  while(fgets(line, sizeof(line), fd))
+  { if(line[0]=='#') continue;
+    char *cp = line, *last = 0, *end;
+    for(;;) // use last number on line
+    { strtod(cp, &end);
+      if(end==cp) break;
+      last = cp; cp = end;
+    }
+    if(last) tr.push_back((uint32_t) strtod(last, 0));
+  }
+  fclose(fd);
+  return tr;
+}
+
+int main(int argc, char *argv[])
+{
+  c_latency lat;
+  lat.stallProb = 16;
+  double duration = 600;
+  int margin = 25;
+  const char *traceName = 0, *outName = 0;
+  std::vector<uint32_t> trace;
+
+  int opt;
+  while((opt = getopt(argc, argv, "n:b:k:c:d:l:r:p:T:t:m:o:")) != -1)
+  { switch(opt)
+    { case 'n': nchList = parseList(optarg); break;
+      case 'b': nbyteList = parseList(optarg); break;
+      case 'k': ndbuf = atoi(optarg); break;
+      case 'c': chunk = atoi(optarg); break;
+      case 'd': duration = atof(optarg); break;
+      case 'l': lat.base = atoi(optarg); break;
+      case 'r': lat.rate = atoi(optarg); break;
+      case 'p': lat.stallProb = atoi(optarg); break;
+      case 'T': lat.stallTime = atoi(optarg); break;
+      case 't': traceName = optarg; break;
+      case 'm': margin = atoi(optarg); break;
+      case 'o': outName = optarg; break;
+      default:
+        fprintf(stderr, "usage: %s [-n nch,..] [-b nbyte,..] [-k ndbuf] [-c chunk] [-d sec] [-l us] [-r rate]"
+                        " [-p prob] [-T us] [-t trace] [-m percent] [-o header]\n", argv[0]);
+        return 1;
+    }
+  }
+  if(traceName)
+  { trace = readTrace(traceName);
+    if(trace.empty()) { fprintf(stderr, "%s: no data\n", traceName); return 1; }
+    lat.setTrace(trace.data(), trace.size());
+  }
+
+  char model[200];
+  if(traceName)
+    snprintf(model, sizeof(model), "trace %s (%zu writes)", traceName, trace.size());
+  else
+    snprintf(model, sizeof(model), "base %u us, rate %u B/us, stall %u us with p=%u/65536",
+      lat.base, lat.rate, lat.stallTime, lat.stallProb);
+
+  printf("NDBUF %d, chunk %u, %.0f s per case\n", ndbuf, chunk, duration);
+  printf("model: %s\n", model);
+  printf("current config: NCH %d, NBYTE %d, MQUEU %d, BUFFERSIZE %d\n\n", NCH, NBYTE, MQUEU, BUFFERSIZE);
+
+  std::vector<sizing_t> sizes;
+  for(int cc: nchList) for(int bb: nbyteList)
+  { nch = cc; nbyte = bb;
+    sizes.push_back(sizeFor(duration, margin, lat));
+  }
+  printf("columns: largest queue fill (blocks per channel) for BUFFERSIZE (words)\n");
+  printf("overrun: card does not keep up with data rate, no size\n");
+
+  if(outName)
+  { FILE *fd = fopen(outName, "w");
+    if(!fd) { perror(outName); return 1; }
+    fprintf(fd, "// generated by host/bin/sizing, do not edit\n");
+    fprintf(fd, "// model: %s\n", model);
+    fprintf(fd, "// NDBUF %d, chunk %u, %.0f s per case, margin %d%%\n", ndbuf, chunk, duration, margin);
+    fprintf(fd, "#ifndef SIZING_H\n#define SIZING_H\n\n");
+    fprintf(fd, "#define SIZING_NFS %zu\n\n", NFSAMPS);
+    fprintf(fd, "constexpr uint32_t sizingFsamp[SIZING_NFS] = {");
+    for(uint32_t ii=0; ii<NFSAMPS; ii++) fprintf(fd, "%s%u", ii? ", ": "", fsamps[ii]);
+    fprintf(fd, "};\n\n");
+    // NPOOL = NCH*MQUEU+6: queues of all channels, I2S and loop()
+    for(size_t kk=0; kk<sizes.size(); kk++)
+    { fprintf(fd, "#%s NCH==%d && NBYTE==%d\n", kk? "elif": "if", sizes[kk].nch, sizes[kk].nbyte);
+      writeTable(fd, "sizingMQUEU", sizes[kk].mqueu);
+      writeTable(fd, "sizingNPOOL", sizes[kk].npool);
+      writeTable(fd, "sizingBUFFERSIZE", sizes[kk].bufsize);
+    }
+    fprintf(fd, "#else\n  #error \"sizing.h: no sizes for this NCH/NBYTE (make -C host sizing)\"\n#endif\n\n");
+    fprintf(fd, "// MQUEU 0: card does not keep up at this rate\n");
+    fprintf(fd, "constexpr bool sizingValid(int ii)\n");
+    fprintf(fd, "{ return ii<0 || ((!sizingMQUEU[ii] || (sizingMQUEU[ii] >= 2 && sizingNPOOL[ii] >= NCH*sizingMQUEU[ii]))\n");
+    fprintf(fd, "    && (sizingBUFFERSIZE[ii]*NBYTE) %% 512 == 0 && sizingValid(ii-1));\n}\n");
+    fprintf(fd, "static_assert(sizingValid(SIZING_NFS-1), \"sizing.h: invalid queue or buffer size\");\n\n");
+    fprintf(fd, "#endif\n");
+    fclose(fd);
+    printf("wrote %s\n", outName);
+  }
+  return 0;
+}
@@ -0,0 +1,273 @@
+/* SGTL5000 Recorder for Teensy
+ * Copyright (c) 2018, Walter Zimmer
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice, development funding notice, and this permission
+ * notice shall be included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+/*
+ * header-only spectral analysis for the host tools
+ *
+ *   c_rfft fft(1024);
+ *   fft.power(x, acc);     // acc[k] += |X[k]|^2, k = 0..n/2, of real x[n]
+ *
+ * real FFT via complex FFT of half length (radix 2, per stage twiddle tables, so the
+ * butterflies run over contiguous memory); sample conversion, windowing, butterflies
+ * and power use AVX2 if the CPU has it (checked at run time), else plain C++
+ *
+ * LTSA file (written by binspec), little endian: ltsaHeader_t, then float[nrows][nbins]
+ * power spectral density in dB re full scale^2/Hz (one sided), row r averages the
+ * spectra from tstart + r*dt
+ */
+#ifndef _SPECTRUM_H
+#define _SPECTRUM_H
+
+#include <stdint.h>
+#include <string.h>
+#include <math.h>
+#include <vector>
+
+#if defined(__x86_64__) || defined(__i386__)
+  #include <immintrin.h>
+  #define SPEC_X86 1
+  #define SPEC_AVX2 __attribute__((target("avx2,fma")))
+#else
+  #define SPEC_X86 0
+#endif
+
+#define LTSA_MAGIC   "LTSA"
+#define LTSA_VERSION 1
+
+typedef struct
+{ char magic[4];        // LTSA_MAGIC
+  uint16_t version;     // LTSA_VERSION
+  uint16_t hdrSize;     // sizeof(ltsaHeader_t)
+  uint32_t nfft;
+  uint32_t nbins;       // nfft/2+1, 0 .. fsamp/2
+  uint32_t nrows;
+  uint32_t fsamp;
+  double tstart;        // first row, seconds since 1970
+  double dt;            // seconds per row
+} ltsaHeader_t;
+
+static_assert(sizeof(ltsaHeader_t) == 40, "ltsaHeader_t must be 40 bytes");
+
+static inline bool specHaveAVX2(void)
+{
+#if SPEC_X86
+  static const bool avx2 = __builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma");
+  return avx2;
+#else
+  return false;
+#endif
+}
+
+//---------------------------------- kernels -------------------------------------
+// one channel of interleaved 16 or 32 bit samples to float (scaled to full scale 1)
+static void specConvert(const uint8_t *src, uint32_t nbyte, uint32_t nch, uint32_t ch, uint32_t n, float *dst)
+{ if(nbyte==2)
+  { const int16_t *ss = (const int16_t *) src + ch;
+    for(uint32_t ii=0; ii<n; ii++) dst[ii] = ss[ii*nch]*(1.0f/32768);
+  }
+  else
+  { const int32_t *ss = (const int32_t *) src + ch;
+    for(uint32_t ii=0; ii<n; ii++) dst[ii] = ss[ii*nch]*(1.0f/2147483648.0f);
+  }
+}
+
+static void specWindow(const float *x, const float *w, float *y, uint32_t n)
+{ for(uint32_t ii=0; ii<n; ii++) y[ii] = x[ii]*w[ii];
+}
+
+// one stage of butterflies (a, b) -> (a + w*b, a - w*b), b = a + half, all groups of 2*half
+static void specStage(float *zr, float *zi, const float *wr, const float *wi, uint32_t half, uint32_t m)
+{ for(uint32_t ii=0; ii<m; ii+=2*half)
+  { float *ar = zr+ii, *ai = zi+ii, *br = zr+ii+half, *bi = zi+ii+half;
+    for(uint32_t jj=0; jj<half; jj++)
+    { float tr = br[jj]*wr[jj] - bi[jj]*wi[jj];
+      float ti = br[jj]*wi[jj] + bi[jj]*wr[jj];
+      br[jj] = ar[jj] - tr; bi[jj] = ai[jj] - ti;
+      ar[jj] += tr; ai[jj] += ti;
+    }
+  }
+}
+
+// power of real spectrum from complex spectrum Z of half length m, bins k0 .. m-1
+static void specUnpack(const float *zr, const float *zi, const float *ur, const float *ui, float *acc, uint32_t m, uint32_t k0)
+{ for(uint32_t kk=k0; kk<m; kk++)
+  { float er = zr[kk] + zr[m-kk], ei = zi[kk] - zi[m-kk];
+    float or_ = zi[kk] + zi[m-kk], oi = zr[m-kk] - zr[kk];
+    float xr = er + ur[kk]*or_ - ui[kk]*oi;
+    float xi = ei + ur[kk]*oi + ui[kk]*or_;
+    acc[kk] += 0.25f*(xr*xr + xi*xi);
+  }
+}
+
+#if SPEC_X86
+SPEC_AVX2 static void specConvertAVX2(const uint8_t *src, uint32_t nbyte, uint32_t nch, uint32_t ch, uint32_t n, float *dst)
+{ if(nch != 1) { specConvert(src, nbyte, nch, ch, n, dst); return; }
+  uint32_t ii = 0;
+  if(nbyte==2)
+  { const __m256 scale = _mm256_set1_ps(1.0f/32768);
+    for(; ii+8<=n; ii+=8)
+    { __m128i ss = _mm_loadu_si128((const __m128i *) (src + 2*ii));
+      _mm256_storeu_ps(dst+ii, _mm256_mul_ps(_mm256_cvtepi32_ps(_mm256_cvtepi16_epi32(ss)), scale));
+    }
+  }
+  else
+  { const __m256 scale = _mm256_set1_ps(1.0f/2147483648.0f);
+    for(; ii+8<=n; ii+=8)
+    { __m256i ss = _mm256_loadu_si256((const __m256i *) (src + 4*ii));
+      _mm256_storeu_ps(dst+ii, _mm256_mul_ps(_mm256_cvtepi32_ps(ss), scale));
+    }
+  }
+  specConvert(src + ii*nbyte, nbyte, 1, 0, n-ii, dst+ii);
+}
+
+SPEC_AVX2 static void specWindowAVX2(const float *x, const float *w, float *y, uint32_t n)
+{ uint32_t ii = 0;
+  for(; ii+8<=n; ii+=8) _mm256_storeu_ps(y+ii, _mm256_mul_ps(_mm256_loadu_ps(x+ii), _mm256_loadu_ps(w+ii)));
+  specWindow(x+ii, w+ii, y+ii, n-ii);
+}
+
+SPEC_AVX2 static void specStageAVX2(float *zr, float *zi, const float *wr, const float *wi, uint32_t half, uint32_t m)
+{ if(half < 8) { specStage(zr, zi, wr, wi, half, m); return; }
+  for(uint32_t ii=0; ii<m; ii+=2*half)
+  { float *ar = zr+ii, *ai = zi+ii, *br = zr+ii+half, *bi = zi+ii+half;
+    for(uint32_t jj=0; jj<half; jj+=8)
+    { __m256 vbr = _mm256_loadu_ps(br+jj), vbi = _mm256_loadu_ps(bi+jj);
+      __m256 vwr = _mm256_loadu_ps(wr+jj), vwi = _mm256_loadu_ps(wi+jj);
+      __m256 tr = _mm256_fmsub_ps(vbr, vwr, _mm256_mul_ps(vbi, vwi));
+      __m256 ti = _mm256_fmadd_ps(vbr, vwi, _mm256_mul_ps(vbi, vwr));
+      __m256 var = _mm256_loadu_ps(ar+jj), vai = _mm256_loadu_ps(ai+jj);
+      _mm256_storeu_ps(br+jj, _mm256_sub_ps(var, tr)); _mm256_storeu_ps(bi+jj, _mm256_sub_ps(vai, ti));
+      _mm256_storeu_ps(ar+jj, _mm256_add_ps(var, tr)); _mm256_storeu_ps(ai+jj, _mm256_add_ps(vai, ti));
+    }
+  }
+}
+
+SPEC_AVX2 static void specUnpackAVX2(const float *zr, const float *zi, const float *ur, const float *ui, float *acc, uint32_t m)
+{ const __m256i rev = _mm256_setr_epi32(7, 6, 5, 4, 3, 2, 1, 0);
+  const __m256 quarter = _mm256_set1_ps(0.25f);
+  uint32_t kk = 1;
+  for(; kk+8<=m; kk+=8)
+  { __m256 ar = _mm256_loadu_ps(zr+kk), ai = _mm256_loadu_ps(zi+kk);
+    __m256 br = _mm256_permutevar8x32_ps(_mm256_loadu_ps(zr+m-kk-7), rev);  // zr[m-k]
+    __m256 bi = _mm256_permutevar8x32_ps(_mm256_loadu_ps(zi+m-kk-7), rev);
+    __m256 er = _mm256_add_ps(ar, br), ei = _mm256_sub_ps(ai, bi);
+    __m256 or_ = _mm256_add_ps(ai, bi), oi = _mm256_sub_ps(br, ar);
+    __m256 wr = _mm256_loadu_ps(ur+kk), wi = _mm256_loadu_ps(ui+kk);
+    __m256 xr = _mm256_fmsub_ps(wr, or_, _mm256_fmsub_ps(wi, oi, er));
+    __m256 xi = _mm256_fmadd_ps(wr, oi, _mm256_fmadd_ps(wi, or_, ei));
+    __m256 pp = _mm256_fmadd_ps(xr, xr, _mm256_mul_ps(xi, xi));
+    _mm256_storeu_ps(acc+kk, _mm256_fmadd_ps(pp, quarter, _mm256_loadu_ps(acc+kk)));
+  }
+  specUnpack(zr, zi, ur, ui, acc, m, kk);
+}
+#endif
+
+//---------------------------------- real FFT ------------------------------------
+class c_rfft
+{
+  public:
+    // n: power of 2, at least 16
+    c_rfft(uint32_t n, bool simd = true) : n(n), m(n/2), avx2(simd && specHaveAVX2())
+    { nbits = 0;
+      while((1u << nbits) < m) nbits++;
+      rev.resize(m);
+      for(uint32_t ii=0; ii<m; ii++)
+      { uint32_t rr = 0;
+        for(uint32_t bb=0; bb<nbits; bb++) if(ii & (1u<<bb)) rr |= 1u << (nbits-1-bb);
+        rev[ii] = rr;
+      }
+      // stage with butterfly span 2*half uses twiddles exp(-2 pi i j/(2*half)), j < half
+      for(uint32_t half=1; half<m; half*=2)
+        for(uint32_t jj=0; jj<half; jj++)
+        { twr.push_back(cos(M_PI*jj/half));
+          twi.push_back(-sin(M_PI*jj/half));
+        }
+      // unpack of real spectrum: exp(-2 pi i k/n)
+      for(uint32_t kk=0; kk<=m; kk++) { ur.push_back(cos(2*M_PI*kk/n)); ui.push_back(-sin(2*M_PI*kk/n)); }
+      zr.resize(m); zi.resize(m);
+    }
+
+    bool simd(void) const { return avx2; }
+
+    // acc[k] += |X[k]|^2 for k = 0..n/2
+    void power(const float *x, float *acc)
+    { for(uint32_t ii=0; ii<m; ii++) { zr[rev[ii]] = x[2*ii]; zi[rev[ii]] = x[2*ii+1]; }
+      // first two stages as radix 4 (twiddles 1 and -i)
+      for(uint32_t ii=0; ii<m; ii+=4)
+      { float *pr = &zr[ii], *pi = &zi[ii];
+        float b0r = pr[0]+pr[1], b0i = pi[0]+pi[1], b1r = pr[0]-pr[1], b1i = pi[0]-pi[1];
+        float b2r = pr[2]+pr[3], b2i = pi[2]+pi[3], b3r = pr[2]-pr[3], b3i = pi[2]-pi[3];
+        pr[0] = b0r+b2r; pi[0] = b0i+b2i; pr[2] = b0r-b2r; pi[2] = b0i-b2i;
+        pr[1] = b1r+b3i; pi[1] = b1i-b3r; pr[3] = b1r-b3i; pi[3] = b1i+b3r;
+      }
+      const float *wr = twr.data()+3, *wi = twi.data()+3;
+      for(uint32_t half=4; half<m; half*=2)
+      {
+#if SPEC_X86
+        if(avx2) specStageAVX2(zr.data(), zi.data(), wr, wi, half, m);
+        else
+#endif
+        specStage(zr.data(), zi.data(), wr, wi, half, m);
+        wr += half; wi += half;
+      }
+      // X[k] = (Z[k] + Z*[m-k])/2 - i W^k (Z[k] - Z*[m-k])/2, only |X[k]|^2 is needed
+      float x0 = zr[0] + zi[0], xm = zr[0] - zi[0];
+      acc[0] += x0*x0;
+      acc[m] += xm*xm;
+#if SPEC_X86
+      if(avx2) { specUnpackAVX2(zr.data(), zi.data(), ur.data(), ui.data(), acc, m); return; }
+#endif
+      specUnpack(zr.data(), zi.data(), ur.data(), ui.data(), acc, m, 1);
+    }
+
+    void window(const float *x, const float *w, float *y) const
+    {
+#if SPEC_X86
+      if(avx2) { specWindowAVX2(x, w, y, n); return; }
+#endif
+      specWindow(x, w, y, n);
+    }
+
+    void convert(const uint8_t *src, uint32_t nbyte, uint32_t nch, uint32_t ch, uint32_t nn, float *dst) const
+    {
+#if SPEC_X86
+      if(avx2) { specConvertAVX2(src, nbyte, nch, ch, nn, dst); return; }
+#endif
+      specConvert(src, nbyte, nch, ch, nn, dst);
+    }
+
+  private:
+    uint32_t n, m, nbits;
+    bool avx2;
+    std::vector<uint32_t> rev;
+    std::vector<float> twr, twi, ur, ui, zr, zi;
+};
+
+// Hann window and factor from power sum to one sided PSD (full scale^2/Hz)
+static inline float specHann(std::vector<float> &w, uint32_t n, uint32_t fsamp)
+{ w.resize(n);
+  double s2 = 0;
+  for(uint32_t ii=0; ii<n; ii++) { w[ii] = 0.5 - 0.5*cos(2*M_PI*ii/n); s2 += w[ii]*w[ii]; }
+  return 2.0/(fsamp*s2);
+}
+
+#endif
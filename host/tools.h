@@ -0,0 +1,195 @@
+/* SGTL5000 Recorder for Teensy
+ * Copyright (c) 2018, Walter Zimmer
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice, development funding notice, and this permission
+ * notice shall be included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+// helpers shared by the host post-processing tools
+
+#ifndef _TOOLS_H
+#define _TOOLS_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include <sys/stat.h>
+
+#include <deque>
+#include <vector>
+#include <string>
+#include <memory>
+#include <functional>
+#include <mutex>
+#include <atomic>
+#include <thread>
+#include <condition_variable>
+
+// thread pool: tasks may push further tasks, run() returns when all are done
+class c_pool
+{
+  public:
+    void push(std::function<void()> task)
+    { std::lock_guard<std::mutex> lk(mtx);
+      tasks.push_back(task);
+      active++;
+      cv.notify_one();
+    }
+
+    void run(int nthreads)
+    { std::vector<std::thread> th;
+      for(int ii=0; ii<nthreads; ii++) th.emplace_back([this] { worker(); });
+      for(auto &tt: th) tt.join();
+    }
+
+  private:
+    std::deque<std::function<void()>> tasks;
+    std::mutex mtx;
+    std::condition_variable cv;
+    int active = 0; // pushed but not finished
+
+    void worker(void)
+    { std::unique_lock<std::mutex> lk(mtx);
+      while(1)
+      { cv.wait(lk, [this] { return !tasks.empty() || !active; });
+        if(tasks.empty()) return;
+        auto task = tasks.front();
+        tasks.pop_front();
+        lk.unlock();
+        task();
+        lk.lock();
+        if(!--active) cv.notify_all();
+      }
+    }
+};
+
+// work-stealing thread pool: each worker pushes to and pops from the back of its own
+// queue (depth first, cache warm), idle workers steal from the front of the others;
+// tasks pushed from outside go to a shared queue. run() returns when all are done
+class c_stealPool
+{
+  public:
+    void push(std::function<void()> task)
+    { int id = (owner() == this)? self(): -1;
+      queue_t &qq = (id >= 0)? *queues[id]: inject;
+      { std::lock_guard<std::mutex> lk(qq.mtx);
+        qq.tasks.push_back(task);
+      }
+      active++;
+      queued++;
+      std::lock_guard<std::mutex> lk(idleMtx);
+      idleCv.notify_one();
+    }
+
+    void run(int nthreads)
+    { queues.clear();
+      for(int ii=0; ii<nthreads; ii++) queues.emplace_back(new queue_t);
+      std::vector<std::thread> th;
+      for(int ii=0; ii<nthreads; ii++) th.emplace_back([this, ii] { worker(ii); });
+      for(auto &tt: th) tt.join();
+      queues.clear();
+    }
+
+    uint64_t steals(void) const { return nSteal; }
+
+  private:
+    typedef struct
+    { std::mutex mtx;
+      std::deque<std::function<void()>> tasks;
+    } queue_t;
+
+    std::vector<std::unique_ptr<queue_t>> queues;
+    queue_t inject;
+    std::atomic<int> active{0};   // pushed but not finished
+    std::atomic<int> queued{0};   // pushed but not started
+    std::atomic<uint64_t> nSteal{0};
+    std::mutex idleMtx;
+    std::condition_variable idleCv;
+
+    static c_stealPool *&owner(void) { static thread_local c_stealPool *pp = 0; return pp; }
+    static int &self(void) { static thread_local int id = -1; return id; }
+
+    bool take(queue_t &qq, bool back, std::function<void()> &task)
+    { std::lock_guard<std::mutex> lk(qq.mtx);
+      if(qq.tasks.empty()) return false;
+      if(back) { task = std::move(qq.tasks.back()); qq.tasks.pop_back(); }
+      else { task = std::move(qq.tasks.front()); qq.tasks.pop_front(); }
+      queued--;
+      return true;
+    }
+
+    bool find(int id, std::function<void()> &task)
+    { if(take(*queues[id], true, task)) return true;
+      for(size_t kk=1; kk<queues.size(); kk++)
+        if(take(*queues[(id+kk) % queues.size()], false, task)) { nSteal++; return true; }
+      return take(inject, false, task);
+    }
+
+    void worker(int id)
+    { owner() = this;
+      self() = id;
+      std::function<void()> task;
+      while(1)
+      { if(find(id, task))
+        { task();
+          task = nullptr;
+          if(!--active) { std::lock_guard<std::mutex> lk(idleMtx); idleCv.notify_all(); }
+          continue;
+        }
+        std::unique_lock<std::mutex> lk(idleMtx);
+        idleCv.wait(lk, [this] { return queued > 0 || !active; });
+        if(!active) break;
+      }
+      owner() = 0;
+      self() = -1;
+    }
+};
+
+// create directories of path (up to last '/')
+static inline void mkdirs(const std::string &path)
+{ for(size_t ii=1; ii<path.size(); ii++)
+    if(path[ii]=='/') mkdir(path.substr(0, ii).c_str(), 0755);
+}
+
+// "yyyy-mm-dd hh:mm:ss[.frac]" (UTC, as RTC) or seconds since 1970
+static inline bool parseTime(const char *str, double &t)
+{ int yy, mo, dd, hh, mi;
+  double ss;
+  if(sscanf(str, "%d-%d-%d %d:%d:%lf", &yy, &mo, &dd, &hh, &mi, &ss)==6)
+  { struct tm tx = {};
+    tx.tm_year = yy-1900; tx.tm_mon = mo-1; tx.tm_mday = dd;
+    tx.tm_hour = hh; tx.tm_min = mi;
+    t = timegm(&tx) + ss;
+    return true;
+  }
+  char *end;
+  t = strtod(str, &end);
+  return end!=str && *end==0;
+}
+
+static inline const char *timeString(double t)
+{ static thread_local char str[64];
+  time_t tt = (time_t) t;
+  struct tm tx;
+  gmtime_r(&tt, &tx);
+  snprintf(str, sizeof(str), "%04d-%02d-%02d %02d:%02d:%06.3f", tx.tm_year+1900, tx.tm_mon+1, tx.tm_mday,
+    tx.tm_hour, tx.tm_min, tx.tm_sec + (t-tt));
+  return str;
+}
+
+#endif
@@ -0,0 +1,7 @@
+// host replacement of Teensy usb_serial.h (see hal_host.h)
+#ifndef _usb_serial_h_
+#define _usb_serial_h_
+
+#include "hal_host.h"
+
+#endif
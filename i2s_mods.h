@@ -225,6 +225,13 @@
     CORE_PIN8_CONFIG  = 3;  //1:RX_DATA0
   }
 
+#elif defined(HOST_BUILD)
+  // I2S is simulated by host DMA (host/hal_host.cpp)
+  void I2S_modification(uint32_t fsamp, uint16_t nbits) { hal_i2s_setRate(fsamp); }
+  void I2S_stopClock(void) { hal_i2s_run(0); }
+  void I2S_startClock(void) { hal_i2s_run(1); }
+  void I2S_stop(void) { hal_i2s_run(0); }
+
 #endif
 
 #endif
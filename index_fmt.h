@@ -0,0 +1,74 @@
+/* SGTL5000 Recorder for Teensy
+ * Copyright (c) 2018, Walter Zimmer
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice, development funding notice, and this permission
+ * notice shall be included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+
+/*
+ * seek index (sidecar file WMXZ_hhmmss.idx next to WMXZ_hhmmss.bin)
+ *
+ * idxHeader_t followed by nent idxEntry_t, one entry every 'every' disk buffers
+ * (every is doubled when the table of a file is full)
+ * each entry gives the position of the first sample of a disk buffer:
+ *   sample  frame number within file (frame: NCH samples; drop markers not counted)
+ *   offset  byte offset of this frame in the .bin file (header is 512 bytes)
+ *   rtc     RTC seconds at capture of this frame
+ *   usec    micros() at capture of this frame (for sub-second timing between entries)
+ * shared by recorder (logger_if.h) and host reader (host/bin_index.h), little endian
+ */
+#ifndef _INDEX_FMT_H
+#define _INDEX_FMT_H
+
+#include <stdint.h>
+
+#define IDX_MAGIC   "WIDX"
+#define IDX_VERSION 1
+
+typedef struct
+{ char magic[4];      // IDX_MAGIC
+  uint16_t version;   // IDX_VERSION
+  uint16_t entrySize; // sizeof(idxEntry_t)
+  uint32_t fsamp;
+  uint16_t nch;
+  uint16_t nbyte;
+} idxHeader_t;
+
+typedef struct
+{ uint64_t sample;
+  uint64_t offset;
+  uint32_t rtc;
+  uint32_t usec;
+} idxEntry_t;
+
+static_assert(sizeof(idxHeader_t) == 16, "idxHeader_t must be 16 bytes");
+static_assert(sizeof(idxEntry_t) == 24, "idxEntry_t must be 24 bytes");
+
+// recorder's table of one file (logger_if.h), N entries; hdr and ent are saved together
+template <int N>
+struct idxTable_t
+{ char path[80];    // .bin file, sidecar is .idx
+  uint16_t every;   // one entry every 'every' disk buffers
+  uint16_t nent;    // number of entries
+  uint32_t nbuf;    // number of disk buffers
+  idxHeader_t hdr;
+  idxEntry_t ent[N];
+};
+
+#endif
@@ -27,16 +27,53 @@
 #include "core_pins.h"
 
 #include "config.h"
+#include "index_fmt.h"
+#include "wav_fmt.h"
 //==================== local uSD interface ========================================
 
 #ifndef BUFFERSIZE
   #define BUFFERSIZE (8*1024)
 #endif
-data_t diskBuffer[BUFFERSIZE];
+#ifndef NDBUF
+  #define NDBUF 3 // number of rotating disk buffers
+#endif
+#ifndef WRITE_CHUNK
+  #define WRITE_CHUNK (4*1024) // max bytes written per call of uSD.service() (default)
+#endif
+#ifndef IDX_EVERY
+  #define IDX_EVERY 1 // seek index entry every IDX_EVERY disk buffers (0: no index)
+#endif
+#ifndef IDX_MAX
+  #define IDX_MAX 128 // entries per file, spacing is doubled when full
+#endif
+#ifndef SD_TEST_BYTES
+  #define SD_TEST_BYTES (64*1024) // bytes written per size by c_uSD::characterize()
+#endif
+
+#define SECTOR_SIZE 512
+static_assert((BUFFERSIZE*sizeof(data_t)) % SECTOR_SIZE == 0, "BUFFERSIZE must be multiple of sector size");
+static_assert(WRITE_CHUNK % SECTOR_SIZE == 0, "WRITE_CHUNK must be multiple of sector size");
+static_assert(WRITE_CHUNK <= BUFFERSIZE*sizeof(data_t), "WRITE_CHUNK must not exceed disk buffer");
+
+// loop() fills diskBuffer while the other buffers are written to disk
+// aligned to cache lines (32 bytes) for DMA and M7 D-cache, on T4 in OCRAM (see config.h)
+data_t diskBuffers[NDBUF][BUFFERSIZE] MEM_PLACE(DBUF_MEM) __attribute__((aligned(32)));
+data_t *diskBuffer = diskBuffers[0];
 data_t *outptr = diskBuffer;
 
-#include "SD.h"
 #include "TimeLib.h"
+#include "fs_if.h"
+
+#ifndef FS_BACKEND
+  #if defined(HOST_BUILD)
+    #define FS_BACKEND FS_POSIX
+  #else
+    #define FS_BACKEND FS_SDFAT
+  #endif
+#endif
+
+#if FS_BACKEND==FS_SDFAT
+#include "SD.h"
 
 #ifndef USE_SDIO
   #define USE_SDIO 0
@@ -89,11 +126,39 @@ void dateTime(uint16_t* date, uint16_t* time, uint8_t* ms10)
   *ms10 = second() & 1 ? 100 : 0;
 }
 
-class c_mFS
+class c_mFS : public c_FS
 {
   private:
   SDClass sd;
-  File file;
+  FsFile file[2];
+  uint16_t cur=0;  // index of file being written
+  int16_t ready=0; // file[1-cur] is open and preallocated (next file)
+  int16_t old=0;   // file[1-cur] is retired and must still be closed
+  uint64_t oldLength=0; // valid bytes of retired file
+
+  // nbytes > 0: reserve contiguous clusters for nbytes (FAT is not updated during writes)
+  // an existing file of same name is truncated (preAllocate needs an empty file)
+  void openFile(FsFile &ff, char * filename, uint64_t nbytes)
+  {
+    ff = sd.sdfs.open(filename, O_RDWR | O_CREAT | O_TRUNC);
+    if(!ff) sd.sdfs.errorHalt("file.open failed");
+    if(nbytes && !ff.preAllocate(nbytes)) sd.sdfs.errorHalt("preAllocate failed");
+  }
+
+  // length: valid bytes, removes unused preallocated clusters and padding of last write
+  void closeFile(FsFile &ff, uint64_t length)
+  {
+    #if OUT_FORMAT==OUT_WAV
+      // WAV sizes are known only now
+      uint8_t hdr[FILE_HDR_BYTES];
+      if(ff.seekSet(0) && ff.read(hdr, FILE_HDR_BYTES)==FILE_HDR_BYTES && wavPatch(hdr, FILE_HDR_BYTES, length))
+      { ff.seekSet(0);
+        ff.write(hdr, FILE_HDR_BYTES);
+      }
+    #endif
+    ff.truncate(length);
+    ff.close();
+  }
   
   public:
     void init(void)
@@ -112,6 +177,13 @@ class c_mFS
 
     void mkDir(char * dirname)  { if(!sd.exists(dirname)) sd.mkdir(dirname);  }
     void chDir(char * dirname)  { sd.sdfs.chdir(dirname);   }
+    int rmDir(char * dirname)   { return sd.sdfs.rmdir(dirname); } // fails if not empty
+    int readCID(uint8_t *cid)
+    { cid_t reg;
+      if(!sd.sdfs.card() || !sd.sdfs.card()->readCID(&reg)) return 0;
+      memcpy(cid, &reg, 16); // cid_t keeps register layout
+      return 1;
+    }
     
     void exit(void)
     {
@@ -127,69 +199,173 @@ class c_mFS
       #endif  
     }
     
-    void open(char * filename)
-    {
-      file = sd.open(filename,FILE_WRITE);
-      if(!file) sd.sdfs.errorHalt("file.open failed");
+    void open(char * filename, uint64_t nbytes) { openFile(file[cur], filename, nbytes); }
+    void close(uint64_t length) { closeFile(file[cur], length); }
+    void remove(void) { file[cur].remove(); } // current file is not used
+
+    // open next file ahead of time 
+    void prepare(char * filename, uint64_t nbytes)
+    { if(ready || old) return;
+      openFile(file[1-cur], filename, nbytes);
+      ready=1;
     }
+    int isReady(void) { return ready; }
 
-    void close(void)
-    {
-      file.truncate();
-      file.close();
+    // switch to prepared file, retired file is closed later by idle()
+    void rotate(uint64_t length) { cur=1-cur; ready=0; old=1; oldLength=length; }
+
+    // close retired file or discard unused next file; returns 1 if some work was done
+    int idle(int discard=0)
+    { if(old) { closeFile(file[1-cur], oldLength); old=0; return 1;}
+      if(ready && discard) { file[1-cur].remove(); ready=0; return 1;}
+      return 0;
     }
 
+    // card is still programming previous data, a write now would block
+    int isBusy(void) { return file[cur].isBusy(); }
+
     uint32_t write(void *buffer, uint32_t nbuf)
     {
-      if (nbuf != file.write(buffer, nbuf)) sd.sdfs.errorHalt("write failed");
+      #if defined(__IMXRT1062__)
+        arm_dcache_flush(buffer, nbuf); // SDIO DMA reads memory, not the D-cache
+      #endif
+      if (nbuf != file[cur].write(buffer, nbuf)) sd.sdfs.errorHalt("write failed");
       return nbuf;
     }
 
     uint32_t read(void *buffer, uint32_t nbuf)
     {      
-      if ((int)nbuf != file.read(buffer, nbuf)) sd.sdfs.errorHalt("read failed");
+      if ((int)nbuf != file[cur].read(buffer, nbuf)) sd.sdfs.errorHalt("read failed");
       return nbuf;
     }
+
+    void save(char * filename, void *buffer, uint32_t nbytes)
+    { FsFile ff = sd.sdfs.open(filename, O_WRONLY | O_CREAT | O_TRUNC);
+      if(!ff) { Serial.print("save failed: "); Serial.println(filename); return; }
+      #if defined(__IMXRT1062__)
+        arm_dcache_flush(buffer, nbytes);
+      #endif
+      ff.write(buffer, nbytes);
+      ff.close();
+    }
 };
 
+#endif // FS_BACKEND==FS_SDFAT
+
+#if FS_BACKEND==FS_POSIX
+  #include "fs_posix.h"
+#endif
+
 class c_uSD
 {
   public:
-    c_uSD(void): state(-1) { }
+    c_uSD(c_FS &fs): state(-1), ibuf(0), npend(0), tail(0), woff(0), fileSize(0), fileBytes(0), tFile(0), tNext(0),
+        iq(0), iw(0), saveMask(0), qBytes(0), qMark(0), fsamp(0), mFS(fs)
+        { lastDir[0]=0; curPath[0]=0; nextPath[0]=0; resetIndex(0); resetIndex(1); memset(stamps, 0, sizeof(stamps)); }
     void init(void);
+    void setFileSize(uint64_t nbytes) { fileSize=nbytes; } // for preallocation
+    void setFsamp(uint32_t fs) { fsamp=fs; } // for seek index
+    // capture time of first sample in disk buffer filled by loop()
+    void stamp(uint32_t rtc, uint32_t usec) { stamps[ibuf].rtc=rtc; stamps[ibuf].usec=usec; }
+    // marker of nbytes inserted into disk buffer (lead: in front of stamped sample)
+    void mark(uint32_t nbytes, int lead) { stamps[ibuf].mark+=nbytes; if(lead) stamps[ibuf].lead+=nbytes; }
     void exit(void);
     void close(void);
+    void discard(void);
 
-    void chDir(void);
     int16_t write(void * data, int32_t ndat, int mustClose);
+    data_t * nextBuffer(void);
+    int16_t service(void);
+    int16_t prepare(void);
+    void flush(void);
+    int16_t characterize(uint32_t required);
+    int16_t identify(void); // read CID of card, returns 0 if not available
+
+    void resume(uint32_t hh); // directory of hour hh exists (retain.h): not created again, 0: none
+    uint16_t npending(void) { return npend; } // disk buffers waiting to be written
 
     uint32_t nCount=0;
+    uint32_t nFiles=0;  // files opened (continued across hibernation, see retain.h)
+    uint32_t dirHour=0; // hour (since 1970) of last directory created
+    uint32_t nBusy=0;   // number of service calls that found card busy
+    uint16_t nPendMax=0; 
+
+    uint32_t writeChunk=WRITE_CHUNK; // max bytes written per call of service()
+    uint32_t cardRate=0;        // bytes/s measured for writeChunk (0: not measured)
+    uint32_t cardMaxLatency=0;  // us, longest single write of writeChunk bytes
+    uint8_t cid[16]={0};        // CID register of card (header_fmt.h), zero if not read (bit 0 of cid[15] is 1 if read)
     int16_t getStatus() {return state;}
     
   private:
-    int16_t state; // 0 initialized; 1 file open; 2 data written; 3 to be closed; -1 error
-
-    c_mFS mFS;
-
+    int16_t state; // 0 initialized; 1 file open; 2 data written; -1 error
+
+    // buffers waiting to be written (FIFO)
+    struct
+    { data_t *data;
+      uint32_t nbytes;  // bytes to write (multiple of SECTOR_SIZE)
+      uint32_t nvalid;  // valid bytes
+      int16_t mustClose;
+    } pending[NDBUF];
+    uint16_t ibuf;  // disk buffer currently filled by loop()
+    uint16_t npend; // number of pending buffers
+    uint16_t tail;  // oldest pending buffer
+    uint32_t woff;  // bytes of oldest pending buffer already written
+
+    uint64_t fileSize; // expected max file size (bytes)
+    uint64_t fileBytes; // valid bytes written to current file
+    uint32_t tFile;    // start time of current file
+    uint32_t tNext;    // start time of prepared file
+    char lastDir[80];  // last directory created
+    char curPath[80];  // file being written
+    char nextPath[80]; // prepared file
+
+    // seek index (index_fmt.h): one table for the file queued by write(),
+    // one for the file still written by service(); saved as sidecar when file is done
+    typedef idxTable_t<IDX_MAX> index_t;
+    index_t idx[2];
+    uint16_t iq;       // table of file queued by write()
+    uint16_t iw;       // table of file written by service()
+    uint16_t saveMask; // tables to be saved
+    uint64_t qBytes;   // valid bytes queued for file by write()
+    uint64_t qMark;    // marker bytes queued for file by write()
+    uint32_t fsamp;
+    struct { uint32_t rtc, usec, mark, lead; } stamps[NDBUF];
+
+    void resetIndex(int ii) { idx[ii].every=IDX_EVERY; idx[ii].nent=0; idx[ii].nbuf=0; idx[ii].path[0]=0; }
+    void addIndex(uint32_t nvalid, int mustClose);
+    void saveIndex(int ii);
+
+    char * makePath(uint32_t tt);
+    void dropDir(const char *path);
+
+    c_FS &mFS;
 };
-c_uSD uSD;
+
+#if FS_BACKEND==FS_SIM
+  c_simFS mFS;
+#elif FS_BACKEND==FS_POSIX
+  c_posixFS mFS;
+#else
+  c_mFS mFS;
+#endif
+c_uSD uSD(mFS);
 
 
 /*
  *  Logging interface support / implementation functions 
  */
 
-char * generateDirectory(char *filename);
-char * generateFilename(char *filename);
+char * generateDirectory(char *filename, uint32_t tt);
+char * generateFilename(char *filename, uint32_t tt);
 
-char *makeDirname(void)
+char *makeDirname(uint32_t tt)
 { static char dirname[80];
-  return generateDirectory(dirname);
+  return generateDirectory(dirname, tt);
 }
 
-char *makeFilename(void)
+char *makeFilename(uint32_t tt)
 { static char filename[80];
-  return generateFilename(filename);
+  return generateFilename(filename, tt);
 }
 
 char * headerUpdate(void);
@@ -203,47 +379,322 @@ void c_uSD::init(void)
 }
 
 void c_uSD::exit(void)
-{ mFS.exit();
+{ close();
+  mFS.exit();
   state=-1;
 }
 
 void c_uSD::close(void)
-{ mFS.close();
+{ flush();
+  int next = mFS.isReady(); // prepared file is discarded
+  if(state==1) mFS.remove(); // rotated to next file, but nothing written
+  if(state==2)
+  { mFS.close(fileBytes);
+    strcpy(idx[iw].path, curPath);
+    saveMask |= 1<<iw;
+  }
+  while(mFS.idle(1)) ; // close retired file and discard prepared one
+  if(saveMask&1) saveIndex(0);
+  if(saveMask&2) saveIndex(1);
+  if(state==1) dropDir(curPath);
+  if(next) dropDir(nextPath);
+  resetIndex(0); resetIndex(1); iq=iw=0; qBytes=qMark=0; memset(stamps, 0, sizeof(stamps));
   state=0;
 }
 
-void c_uSD::chDir(void)
-{ char * dirName=makeDirname();
-  mFS.mkDir(dirName);
-  mFS.chDir(dirName);
+// write pending buffers and delete current file (e.g. after benchmark)
+void c_uSD::discard(void)
+{ flush();
+  int next = mFS.isReady();
+  if(state>0) mFS.remove();
+  while(mFS.idle(1)) ;
+  if(state>0) dropDir(curPath);
+  if(next) dropDir(nextPath);
+  resetIndex(0); resetIndex(1); iq=iw=0; qBytes=qMark=0; memset(stamps, 0, sizeof(stamps)); saveMask=0;
+  state=0;
+}
+
+// remove directory of a removed file, and its day directory, if they are now empty
+// (e.g. hour directory made by prepare() for a next file that was not used)
+void c_uSD::dropDir(const char *path)
+{ char dir[80];
+  snprintf(dir, sizeof(dir), "%s", path);
+  char *cp = strrchr(dir, '/');
+  if(!cp || cp==dir) return;
+  *cp = 0;
+  if(!mFS.rmDir(dir)) return;
+  lastDir[0] = 0; dirHour = 0; // made again when needed
+  cp = strrchr(dir, '/');
+  if(cp && cp!=dir) { *cp = 0; mFS.rmDir(dir); }
+}
+
+/*
+ * seek index: entry for disk buffer queued by write()
+ * a file starts with the header (FILE_HDR_BYTES), so its first entry points behind header
+ */
+void c_uSD::addIndex(uint32_t nvalid, int mustClose)
+{
+  index_t &ix = idx[iq];
+  if(ix.nbuf % ix.every == 0)
+  { if(ix.nent == IDX_MAX)
+    { // table full: keep every second entry
+      for(int ii=0; ii<IDX_MAX/2; ii++) ix.ent[ii] = ix.ent[2*ii];
+      ix.nent = IDX_MAX/2;
+      ix.every *= 2;
+    }
+    if(ix.nbuf % ix.every == 0)
+    { idxEntry_t &ee = ix.ent[ix.nent++];
+      ee.offset = (qBytes? qBytes: FILE_HDR_BYTES) + stamps[ibuf].lead;
+      ee.sample = (ee.offset-FILE_HDR_BYTES-qMark-stamps[ibuf].lead)/(NCH*sizeof(data_t));
+      ee.rtc = stamps[ibuf].rtc;
+      ee.usec = stamps[ibuf].usec;
+    }
+  }
+  ix.nbuf++;
+  qBytes += nvalid;
+  qMark += stamps[ibuf].mark;
+  stamps[ibuf].mark = stamps[ibuf].lead = 0;
+
+  if(mustClose)
+  { // next file: table must no longer be in use by service() nor wait for saving
+    iq = 1-iq;
+    while(iw==iq && npend && state>=0) service();
+    if(saveMask & (1<<iq)) saveIndex(iq);
+    resetIndex(iq);
+    qBytes=qMark=0;
+  }
+}
+
+// write sidecar (.idx) of table ii
+void c_uSD::saveIndex(int ii)
+{
+  index_t &ix = idx[ii];
+  saveMask &= ~(1<<ii);
+  if(!ix.path[0] || !ix.nent) return;
+
+  char name[80];
+  strcpy(name, ix.path);
+  char *ext = strrchr(name, '.');
+  if(ext) strcpy(ext, ".idx");
+
+  memcpy(ix.hdr.magic, IDX_MAGIC, 4);
+  ix.hdr.version = IDX_VERSION;
+  ix.hdr.entrySize = sizeof(idxEntry_t);
+  ix.hdr.fsamp = fsamp;
+  ix.hdr.nch = NCH;
+  ix.hdr.nbyte = sizeof(data_t);
+  mFS.save(name, &ix.hdr, sizeof(idxHeader_t) + ix.nent*sizeof(idxEntry_t));
+  ix.path[0]=0;
+}
+
+// full path name of file starting at time tt, directory is created if needed
+char * c_uSD::makePath(uint32_t tt)
+{ static char path[160];
+  char *dirname = makeDirname(tt);
+  char *filename = makeFilename(tt);
+  if(!dirname || !filename) return 0;
+  if(strcmp(dirname,lastDir))
+  { mFS.mkDir(dirname);
+    strcpy(lastDir,dirname);
+    dirHour = tt/3600;
+  }
+  sprintf(path,"%s/%s",dirname,filename);
+  return path;
+}
+
+void c_uSD::resume(uint32_t hh)
+{ if(!hh) { lastDir[0]=0; dirHour=0; return; } // directory is created again
+  char *dirname = makeDirname(hh*3600);
+  if(dirname) { strcpy(lastDir,dirname); dirHour = hh; }
 }
 
+/*
+ * queue disk buffer for writing (ndat data words)
+ * returns immediately unless all NDBUF buffers are pending
+ * return value is state as seen by loop(): 0 file closed, 2 data written
+ * a partial (last) buffer is zero padded to full sectors, 
+ * so that all writes stay sector aligned; padding is removed at close
+ */
 int16_t c_uSD::write(void *data, int32_t ndat, int mustClose)
 {
+  if(state<0) return state;
+
+  uint32_t nvalid = ndat*sizeof(data_t);
+  uint32_t nbytes = (nvalid + SECTOR_SIZE-1) & ~(SECTOR_SIZE-1);
+  if(nbytes>nvalid) memset((char *) data + nvalid, 0, nbytes-nvalid);
+
+  if(IDX_EVERY>0) addIndex(nvalid, mustClose);
+
+  uint16_t ii = (tail+npend) % NDBUF;
+  pending[ii].data = (data_t *) data;
+  pending[ii].nbytes = nbytes;
+  pending[ii].nvalid = nvalid;
+  pending[ii].mustClose = mustClose;
+  npend++;
+  if(npend>nPendMax) nPendMax=npend;
+
+  // no free buffer left for loop(): must wait for disk
+  while(npend >= NDBUF) { service(); if(state<0) return state; }
+
+  return mustClose? 0: 2;
+}
+
+// disk buffer to be filled next by loop()
+data_t * c_uSD::nextBuffer(void)
+{
+  ibuf = (ibuf+1) % NDBUF;
+  return diskBuffers[ibuf];
+}
+
+/*
+ * writer state machine, called from every loop() iteration
+ * writes at most WRITE_CHUNK bytes of oldest pending buffer
+ * but only if card is not busy, so that loop() is not blocked
+ */
+int16_t c_uSD::service(void)
+{
+  if(!npend || state<0) return state;
+  if(mFS.isBusy()) { nBusy++; return state; } // come back later
+
   if(state == 0)
-  { // open file
-    char *filename = makeFilename();
+  { // open file (next file was not prepared in time)
+    tFile = now();
+    char *filename = makePath(tFile);
     if(!filename) {state=-1; return state;} // flag to do nothing anymore
     //
-    mFS.open(filename);
+    mFS.open(filename, fileSize);
+    strcpy(curPath, filename);
+    fileBytes=0;
+    nFiles++;
 
     state=1; // flag that file is open
   }
-  
-  if(state == 1 || state == 2)
-  {  // write to disk
-    state=2;
-    mFS.write((unsigned char *) data, 2*ndat);
+
+  uint32_t nb = pending[tail].nbytes - woff;
+  if(nb > writeChunk) nb = writeChunk;
+  mFS.write((unsigned char *) pending[tail].data + woff, nb);
+  woff += nb;
+  state=2;
+
+  if(woff == pending[tail].nbytes)
+  { // buffer done
     nCount++;
-    if(mustClose) state=3;
-  }
-  
-  if(state == 3)
-  {
-    mFS.close();
-    state=0;  // flag to open new file
+    fileBytes += pending[tail].nvalid;
+    if(pending[tail].mustClose) 
+    { if(IDX_EVERY>0)
+      { // file done: index can be saved
+        strcpy(idx[iw].path, curPath);
+        saveMask |= 1<<iw;
+        iw = 1-iw;
+      }
+      if(mFS.isReady())
+      { // next file is already open: only swap files, old one is closed by prepare()
+        mFS.rotate(fileBytes);
+        tFile=tNext;
+        nFiles++;
+        strcpy(curPath, nextPath);
+        state=1;
+      }
+      else
+      { mFS.close(fileBytes);
+        state=0;  // flag to open new file
+      }
+      fileBytes=0;
+    }
+    tail = (tail+1) % NDBUF;
+    npend--;
+    woff=0;
   }
   return state;
 }
 
+/*
+ * to be called when loop() is idle
+ * closes the retired file or creates and preallocates the next file
+ * (and its directory), so that file rotation in service() is only a swap
+ */
+int16_t c_uSD::prepare(void)
+{
+  if(state<=0 || mFS.isBusy()) return 0;
+  if(saveMask) { saveIndex((saveMask&1)? 0: 1); return 1; }
+  if(mFS.idle()) return 1;
+  if(mFS.isReady()) return 0;
+
+  tNext = (tFile/t_on + 1)*t_on; // next file boundary (see record_or_sleep)
+  char *filename = makePath(tNext);
+  if(!filename) return 0;
+  mFS.prepare(filename, fileSize);
+  strcpy(nextPath, filename);
+  return 1;
+}
+
+// write all pending buffers (blocking)
+void c_uSD::flush(void)
+{
+  while(npend && state>=0) service();
+}
+
+/*
+ * time writes of different sizes (sector size up to disk buffer size)
+ * into a scratch file and choose the smallest write size that achieves
+ * at least 90% of the best rate, so that service() blocks loop() as little as possible
+ * returns 0 if card cannot sustain required bytes/s
+ */
+int16_t c_uSD::characterize(uint32_t required)
+{
+  const uint32_t maxSize = BUFFERSIZE*sizeof(data_t);
+  uint32_t rate[16], tmax[16], size[16];
+  int nn=0;
+
+  identify(); // rate and latency belong to this card
+
+  // a scratch file left by an interrupted test is truncated by open
+  char name[] = "/SDTEST.TMP";
+  mFS.open(name, 16*SD_TEST_BYTES);
+  while(mFS.isBusy()) ;
+
+  for(uint32_t nb=SECTOR_SIZE; nb<=maxSize && nb<=SD_TEST_BYTES && nn<16; nb*=2, nn++)
+  { size[nn]=nb; tmax[nn]=0;
+    uint32_t t0=micros();
+    for(uint32_t kk=0; kk<SD_TEST_BYTES; kk+=nb)
+    { uint32_t t1=micros();
+      while(mFS.isBusy()) ;
+      mFS.write(diskBuffers[0], nb);
+      uint32_t dt=micros()-t1;
+      if(dt>tmax[nn]) tmax[nn]=dt;
+    }
+    while(mFS.isBusy()) ;
+    uint32_t dt=micros()-t0;
+    rate[nn] = (uint32_t) ((uint64_t) SD_TEST_BYTES*1000000/(dt? dt: 1));
+  }
+  mFS.remove();
+
+  uint32_t best=0;
+  for(int ii=0; ii<nn; ii++) if(rate[ii]>best) best=rate[ii];
+  int ic=nn-1;
+  for(int ii=0; ii<nn; ii++) if(rate[ii] >= best-best/10) { ic=ii; break; }
+  writeChunk = size[ic];
+  cardRate = rate[ic];
+  cardMaxLatency = tmax[ic];
+
+  #if DO_DEBUG>0
+    if(cid[15] & 1) Serial.printf("uSD card: mid 0x%02x oem %.2s product %.5s\n", cid[0], (char *) cid+1, (char *) cid+3);
+    Serial.println("uSD write test: size  kB/s  max us");
+    for(int ii=0; ii<nn; ii++)
+      Serial.printf("%s %6d %6d %6d\n", (ii==ic)? "  *": "   ", size[ii], rate[ii]/1024, tmax[ii]);
+  #endif
+  if(cardRate<required)
+  { Serial.printf("WARNING: uSD writes %d B/s, but %d B/s are required\n", cardRate, required);
+    return 0;
+  }
+  return 1;
+}
+
+int16_t c_uSD::identify(void)
+{
+  if(mFS.readCID(cid)) return 1;
+  memset(cid, 0, sizeof(cid));
+  return 0;
+}
+
 #endif
@@ -58,7 +58,7 @@
 #ifndef AUDIO_BLOCK_SAMPLES
   #if defined(__MK20DX128__) || defined(__MK20DX256__) \
       || defined(__MK64FX512__) || defined(__MK66FX1M0__) \
-      || defined(__IMXRT1062__) 
+      || defined(__IMXRT1062__) || defined(HOST_BUILD)
     #define AUDIO_BLOCK_SAMPLES  128
   #elif defined(__MKL26Z64__)
     #define AUDIO_BLOCK_SAMPLES  64
@@ -76,14 +76,16 @@
 #define AUDIO_BLOCK_SAMPLES_NCH (AUDIO_BLOCK_SAMPLES*NCH)
 
 #define mAudioMemory16(num) ({ \
+  static_assert((num) <= MAX_BLOCKS, "mAudioMemory: more blocks than MAX_BLOCKS (MAX_AUDIO_MEMORY)"); \
 	static maudio_block_t audio_data[num]; \
-  static int16_t audioBuffer[num*AUDIO_BLOCK_SAMPLES_NCH]; \
+  static int16_t audioBuffer[num*AUDIO_BLOCK_SAMPLES_NCH] MEM_PLACE(POOL_MEM); \
 	mAudioStream::initialize_memory(audio_data, num, audioBuffer, sizeof(audioBuffer[0])); \
 })
 
 #define mAudioMemory32(num) ({ \
+  static_assert((num) <= MAX_BLOCKS, "mAudioMemory: more blocks than MAX_BLOCKS (MAX_AUDIO_MEMORY)"); \
 	static maudio_block_t audio_data[num]; \
-  static int32_t audioBuffer[num*AUDIO_BLOCK_SAMPLES_NCH]; \
+  static int32_t audioBuffer[num*AUDIO_BLOCK_SAMPLES_NCH] MEM_PLACE(POOL_MEM); \
 	mAudioStream::initialize_memory(audio_data, num, audioBuffer, sizeof(audioBuffer[0])); \
 })
 
@@ -97,6 +99,7 @@ typedef struct maudio_block_struct {
   uint8_t  ref_count;
   uint8_t  dataSize;
   uint16_t memory_pool_index;
+  uint32_t seq;   // sequence number, set by source (I2S_32)
   void * data;
 //  #if NBYTE==2
 //    int16_t  data[AUDIO_BLOCK_SAMPLES_NCH];
@@ -195,7 +198,7 @@ private:
     #define MAX_AUDIO_MEMORY 163840
   #elif defined(__MK66FX1M0__)
     #define MAX_AUDIO_MEMORY (882*260)
-  #elif defined(__IMXRT1062__)
+  #elif defined(__IMXRT1062__) || defined(HOST_BUILD)
       #define MAX_AUDIO_MEMORY (1024*260)
   #endif
 #elif NBYTE==4
@@ -209,7 +212,7 @@ private:
     #define MAX_AUDIO_MEMORY 163840
   #elif defined(__MK66FX1M0__)
     #define MAX_AUDIO_MEMORY (444*516)
-  #elif defined(__IMXRT1062__)
+  #elif defined(__IMXRT1062__) || defined(HOST_BUILD)
     #define MAX_AUDIO_MEMORY (512*516)
   #endif
 #endif
@@ -250,7 +253,7 @@ void mAudioStream::initialize_memory(maudio_block_t *data, unsigned int num, voi
     data[i].memory_pool_index = i;
     data[i].dataSize = element_size;
     if (dataBuffers) { 
-			data[i].data = (char *)dataBuffers + i*dataSize*AUDIO_BLOCK_SAMPLES; 
+			data[i].data = (char *)dataBuffers + i*dataSize*AUDIO_BLOCK_SAMPLES_NCH; 
 		}
   }
   __enable_irq();
@@ -361,7 +364,7 @@ maudio_block_t * mAudioStream::receiveWritable(unsigned int index)
   inputQueue[index] = NULL;
   if (in && in->ref_count > 1) {
     p = allocate();
-    if (p) memcpy(p->data, in->data, p->dataSize * AUDIO_BLOCK_SAMPLES);
+    if (p) memcpy(p->data, in->data, p->dataSize * AUDIO_BLOCK_SAMPLES_NCH);
     in->ref_count--;
     in = p;
   }
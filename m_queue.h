@@ -52,6 +52,7 @@ public:
 	void clear(void);
 	void * readBuffer(void);
 	void freeBuffer(void);
+	uint32_t sequence(void) { return userblock? userblock->seq: 0; } // of block returned by readBuffer
 	virtual void update(void);
 
 	uint32_t dropCount=0;
@@ -62,14 +63,13 @@ private:
 	maudio_block_t *userblock;
 	volatile uint16_t head, tail, enabled;
 
-  //temp variables
-  uint16_t h, t;
-
 };
 
 template <int MQ>
 int mRecordQueue<MQ>::available(void)
 {
+	uint16_t h, t;
+
 	h = head;
 	t = tail;
 	if (h >= t) return h - t;
@@ -79,6 +79,8 @@ int mRecordQueue<MQ>::available(void)
 template <int MQ>
 void mRecordQueue<MQ>::clear(void)
 {
+	uint16_t t;
+
 	if (userblock) {
 		release(userblock);
 		userblock = NULL;
@@ -94,6 +96,8 @@ void mRecordQueue<MQ>::clear(void)
 template <int MQ>
 void * mRecordQueue<MQ>::readBuffer(void)
 {
+	uint16_t t;
+
 	if (userblock) return NULL;
 	t = tail;
 	if (t == head) return NULL;
@@ -115,6 +119,7 @@ template <int MQ>
 void mRecordQueue<MQ>::update(void)
 {
 	maudio_block_t *block;
+	uint16_t h;
 
 	block = receiveReadOnly();
 	if (!block) return;
@@ -71,135 +71,143 @@ AudioControlSGTL5000 audioShield;
 #include "sgtl5000_mods.h"
 
 #include "logger_if.h"
+#include "marker_fmt.h"
+#include "header_fmt.h"
+#include "wav_fmt.h"
+#include "multiplex.h"
 #include "hibernate.h"
+#include "schedule.h"
+#include "retain.h"
+#include "governor.h"
+#include "mem_budget.h"
+#if (DO_BENCH>0) && (AUDIO_MODE==WMXZ)
+  #include "bench.h"
+#endif
 
 // ************************* utility for logger ***************************************
-char * headerUpdate(void)
+#if USE_WFI>0
+static inline void waitForInterrupt(void)
 {
-  static char header[512];
-  sprintf(&header[0], "WMXZ"); // MAGIC word for header
-  
-  sprintf(&header[4], "%04d_%02d_%02d_%02d_%02d_%02d", year(), month(), day(), hour(), minute(), second());
-  header[23]=0;
+  #if defined(HOST_BUILD)
+    hal_wfi(); // returns at next DMA interrupt, at most after 1 ms
+  #else
+    __disable_irq();
+    if(queue[NCH-1].available() < loopBatch()) asm volatile("wfi"); // ends at once if an interrupt is pending
+    __enable_irq();
+  #endif
+}
+#endif
 
-  // add more info to header
+// RTC second at a past micros() value: micros() of the last RTC second edge seen by loop()
+// (index entries need the second containing the stamped frame, not the one of dequeuing)
+// until the first edge, all frames (queued after first call in setup()) are in the start second
+static uint32_t rtcRef=0, usRef=0;
+static int rtcEdge=-1;
+static inline void rtcTrack(void)
+{ uint32_t us = micros(), rtc = rtc_get();
+  if(rtc != rtcRef) { rtcRef = rtc; usRef = us; if(rtcEdge<1) rtcEdge++; }
+}
+static inline uint32_t rtcAt(uint32_t usec)
+{ int32_t dt = (int32_t) (usec - usRef);
+  if(rtcEdge<=0) return rtcRef;
+  return (dt>=0)? rtcRef + dt/1000000: rtcRef - (999999-dt)/1000000;
+}
+
+// boot profile (header_fmt.h): end of each phase of setup(), stored in first file header
+hdrBoot_t bootProf;
+static inline void bootMark(int phase) { bootProf.t[phase] = micros(); }
+
+extern int fr;
+char * headerUpdate(void)
+{
+  static hdr_t header;
+  memset(&header, 0, sizeof(header));
+  uint32_t tt = now();
+
+  memcpy(header.magic, HDR_MAGIC, 4);
+  snprintf(header.date, sizeof(header.date), "%04u_%02u_%02u_%02u_%02u_%02u", // fields bounded to fit
+    (unsigned) year(tt)%10000, (unsigned) month(tt)%100, (unsigned) day(tt)%100,
+    (unsigned) hour(tt)%100, (unsigned) minute(tt)%100, (unsigned) second(tt)%100);
+  header.millis = millis();
+  header.micros = micros();
+  //
+  header.fsamp = fsamps[fr];
+  header.a_on = a_on;
+  header.a_off = a_off;
+  header.t_on = t_on;
+  //
+  // first two record periods (0,0: none)
+  header.r_h1s = (R_NPER>0)? r_hours[0][0]: 0;
+  header.r_h1e = (R_NPER>0)? r_hours[0][1]: 0;
+  header.r_h2s = (R_NPER>1)? r_hours[1][0]: 0;
+  header.r_h2e = (R_NPER>1)? r_hours[1][1]: 0;
+  header.nch = NCH;
+  header.nbyte = NBYTE;
+  header.sel_lr = SEL_LR;
+  header.audio_select = AUDIO_SELECT;
+  header.mic_gain = MicGain;
+  header.audio_mode = AUDIO_MODE;
   //
-  uint32_t *ptr = (uint32_t*) &header[24];
-  ptr[0]=millis();
-  ptr[1]=micros();
+  header.cardRate = uSD.cardRate;
+  header.cardMaxLatency = uSD.cardMaxLatency;
+  header.writeChunk = uSD.writeChunk;
+  header.markSize = (MARK_DROPS>0)? sizeof(markRecord_t): 0;
+  if(uSD.cid[15] & 1) hdrCardFromCID(header.card, uSD.cid);
   //
-  ptr[2] = fsamps[FSI];
-  ptr[3] = (uint32_t) a_on;
-  ptr[4] = (uint32_t) a_off;
-  ptr[5] = (uint32_t) t_on;
+  memcpy(header.extMagic, HDR_EXT_MAGIC, 4);
+  header.version = HDR_VERSION;
+  header.size = FILE_HDR_BYTES; // first sample
+  header.rtc = tt;
+  header.blockSamples = AUDIO_BLOCK_SAMPLES_NCH;
+  header.bufferBytes = BUFFERSIZE*NBYTE;
   //
-  uint16_t *sptr= (uint16_t *) &ptr[6];
-  sptr[0] = r_h1s;
-  sptr[1] = r_h1e;
-  sptr[2] = r_h2s;
-  sptr[3] = r_h2e;
-  sptr[4] = NCH;
-  sptr[5] = NBYTE;
-  sptr[6] = SEL_LR;
-  sptr[7] = AUDIO_SELECT; 
-  sptr[8] = MicGain; 
-  sptr[9] = AUDIO_MODE;
+  header.format.codec = HDR_CODEC_PCM;
+  header.format.nbyte = NBYTE;
+  header.format.validBits = (AUDIO_MODE==WMXZ && NBYTE==4)? 24: 8*NBYTE; // I2S_32 shifts 32 bit slots by 8
+  header.format.nch = NCH;
+  for(int ii=0; ii<NCH; ii++) header.format.chanMap[ii] = (NCH==1)? SEL_LR: ii;
   //
-  ptr = (uint32_t*) &sptr[10]; // for future values
+  static int bootSaved = 0;
+  if(!bootSaved && bootProf.t[HDR_BOOT_FIRST])
+  { header.boot = bootProf;
+    header.boot.nphase = HDR_BOOT_PHASES;
+    bootSaved = 1;
+  }
   //
-  return header;
+  header.crc = hdrCrc(&header, offsetof(hdr_t, crc));
+  return (char *) &header;
 }
 
 //******************************Auxillary functions **********************
 #include "TimeLib.h"
 time_t getTime() { return Teensy3Clock.get(); }
 
-char * generateDirectory(char *filename)
+char * generateDirectory(char *filename, uint32_t tt)
 {
-  sprintf(filename, "/%s_%04d%02d%02d/%02d", DirPrefix, year(), month(), day(), hour());
+  sprintf(filename, "/%s_%04d%02d%02d/%02d", DirPrefix, year(tt), month(tt), day(tt), hour(tt));
   #if DO_DEBUG>0
     Serial.println(filename);
   #endif
   return filename;
 }
 
-char * generateFilename(char *filename)
+char * generateFilename(char *filename, uint32_t tt)
 {
-	sprintf(filename, "%s_%02d%02d%02d.bin", FilePrefix, hour(), minute(), second());
+	sprintf(filename, "%s_%02d%02d%02d.%s", FilePrefix, hour(tt), minute(tt), second(tt), FILE_EXT);
   #if DO_DEBUG>0
     Serial.println(filename);
   #endif
   return filename;
 }
 
-uint16_t newHour(void)
-{
-  static int lastHour=-1;
-  int _hour = hour();
-  if(_hour == lastHour) return 0;
-  lastHour = _hour;
-  return 1;
-}
-
-/*
- * timed recording examples
- * 7,7: 7==7                     : 24
- * 7,8: 8 > 7      : t<7         : 7-t
- *                   t>=8        : 7+24-t
- * 8,7: 7 < 8      : t<8 & t>=7  : 8-t 
- * 
- * 7,8 9,10: 10 > 7: t<7        : 7-t
- *                   t>=10      : 7+24-t
- *                   t>=8 & t<9 : 9-t
- * 7,8,9,6:   6 < 7: t>=6 & t<7 : 7-t
- *                   t>=8 & t<9 : 9-t   
- */
+// record periods, duty cycle and file length from config.h, see schedule.h
+c_schedule sched;
+static_assert(R_NPER <= SCHED_MAX_PERIODS, "too many record periods (r_hours)");
 
+// 0: keep recording, -1: end of file, >0: seconds to hibernate
 int32_t record_or_sleep(void)
 {
-	uint32_t tt = (uint32_t) now();
-	int32_t ret = 0; // default: keep recording
-
-  uint32_t ttd = tt % (24*3600);
-
-  uint32_t r_t1s = r_h1s*3600;
-  uint32_t r_t1e = r_h1e*3600;
-  uint32_t r_t2s = r_h2s*3600;
-  uint32_t r_t2e = r_h2e*3600;
-  if(r_t2s<0)
-  { // only one period per day
-    if(r_t1e == r_t1s) ret=24*3600; //should not happen
-    //
-    if(r_t1e > r_t1s) // sleep over midnight
-    { if(ttd <  r_t1s) ret = r_t1s - ttd;
-      if(ttd >= r_t1e) ret = (r_t1s +24*3600) - ttd;
-    }
-    else  if((ttd >= r_t1e) && (ttd < r_t1s)) ret = (r_t1s - ttd);
-  }
-  else
-  { // two periods per day
-
-    if(r_t2e > r_t1s) // sleep over midnight
-    {
-      if(ttd <  r_t1s) ret = (r_t1s -ttd);
-      if(ttd >= r_t2e) ret = (r_t1s +24*3600)-ttd; 
-    }
-    else if((ttd >= r_t2e) && (ttd < r_t1s)) ret = (r_t1s - ttd);
-
-    if((r_t2s>r_t1e) && (ttd >= r_t1e) && (ttd < r_t2s)) ret = (r_t2s - ttd);
-  }
-
-  static uint32_t tso=0;
-  uint32_t tsx = tt % t_on;           // time into file
-  uint32_t tsy = tt % (a_on + a_off); // time into aquisition
-
-  if(!ret)
-  {
-    if((tsy >= a_on) && (a_off>0))   // check end of aquisition
-      ret = (a_on + a_off - tsy);
-    else if (tsx < tso)              // check end of file
-      ret = -1;
-  }
+  int32_t ret = sched.check((uint32_t) now()); // one compare until next file end or end of recording
    #if DO_DEBUG>0
     if(ret) 
     {  Serial.print("nsec = ");
@@ -207,8 +215,6 @@ int32_t record_or_sleep(void)
       Serial.flush();
     }
   #endif
-  tso=tsx;
-  //
 	return (ret); 
 }
 
@@ -216,12 +222,33 @@ int32_t record_or_sleep(void)
   extern "C" uint32_t set_arm_clock(uint32_t frequency);
 #endif
 
+// state retained across hibernation (retain.h)
+// warm wake-up: no USB wait, no uSD write test, codec not set up again (if it stayed powered)
+#if defined(__IMXRT1062__)
+  #define RETAIN_CODEC 0 // T4 shutdown also powers down the audio board
+#else
+  #define RETAIN_CODEC 1 // SGTL5000 keeps its registers while K66 is in VLLS0
+#endif
+retain_t retained;
+int warmBoot=0;
+
+// CPU clock from measured load of loop() (governor.h)
+c_governor gov;
+
+uint8_t configHash(void)
+{ const uint32_t cfg[] = {fsamps[fr], NCH, NBYTE, OUT_FORMAT, BUFFERSIZE, AUDIO_SELECT, MicGain, SEL_LR};
+  return retainConfig(cfg, sizeof(cfg)/sizeof(cfg[0]));
+}
+
 void printDate(void)
 { 
    Serial.printf("%04d-%02d-%02d %02d:%02d:%02d\r\n",year(),month(),day(), hour(),minute(),second()); 
 }
 
 extern int do_acq;
+uint32_t seqNext=0; // sequence number of next audio block
+int seqValid=0;     // seqNext known (not after start of acquisition)
+
 void startAcq(void)
 {
   #if DO_DEBUG >0
@@ -230,16 +257,32 @@ void startAcq(void)
   SGTL5000_enable();
   I2S_startClock();
   do_acq=1;
+  seqValid=0;
+  sched.reset();
   for(int ii=0; ii<NCH; ii++) queue[ii].clear();
 }
 
-void stopAcq(int nsec)
+// warm: next wake-up may resume with retained state
+void stopAcq(int nsec, int warm=1)
 {
   #if DO_DEBUG >0
     printDate();
   #endif
   SGTL5000_disable();
   I2S_stopClock();
+  if(warm)
+  { retained.alarm = rtc_get() + nsec;
+    retained.dirHour = uSD.dirHour;
+    retained.files = uSD.nFiles;
+    retained.cardRate = uSD.cardRate;
+    retained.writeChunk = uSD.writeChunk;
+    retained.cardMaxLatency = uSD.cardMaxLatency;
+    retained.cfg = configHash();
+    if(uSD.cid[15] & 1) retained.card = retainCard(uSD.cid); // else card not mounted yet: unchanged
+    retainSave(retained);
+  }
+  else
+    retainClear();
   setWakeupCallandSleep(nsec);
 }
 
@@ -251,14 +294,27 @@ int fr = FSI;
 
 extern "C" void setup() {
   // put your setup code here, to run once:
+  bootMark(HDR_BOOT_ENTRY);
+
+  // woken up by alarm with unchanged configuration?
+  uint32_t tWake = rtc_get();
+  warmBoot = retainLoad(retained) && (retained.cfg == configHash())
+          && (tWake + RETAIN_EARLY >= retained.alarm) && (tWake <= retained.alarm + RETAIN_LATE);
+  retainClear(); // a reset while recording is no wake-up
+  bootProf.flags = warmBoot? HDR_BOOT_WARM: 0;
 
   #if DO_DEBUG>0
-    while(!Serial && (millis()<3000));
+    if(!warmBoot) while(!Serial && (millis()<3000));
     Serial.println("\nVersion: "  __DATE__  " "  __TIME__);
+    if(warmBoot) Serial.printf("warm wake-up (file %d)\n", retained.files);
   #endif
 
-  #if defined(__IMXRT1062__)
+  #if USE_GOVERNOR>0
+    gov.begin(); // highest clock for setup, lowered by load measured in loop()
+  #elif defined(__IMXRT1062__)
     set_arm_clock(24000000);
+  #endif
+  #if defined(__IMXRT1062__)
     #if DO_DEBUG>1
         Serial.print("F_CPU_ACTUAL=");
         Serial.println(F_CPU_ACTUAL);
@@ -267,7 +323,7 @@ extern "C" void setup() {
 
   // set the Time library to use Teensy 3.0's RTC to keep time
   setSyncProvider(getTime);
-  delay(100);
+  if(!warmBoot) delay(100);
   #if DO_DEBUG >1
     if (timeStatus()!= timeSet) {
       Serial.println("Unable to sync with the RTC");
@@ -278,15 +334,29 @@ extern "C" void setup() {
   #if DO_DEBUG >0
     printDate();
   #endif
+  bootMark(HDR_BOOT_RTC);
 
   #if NBYTE==2
-    mAudioMemory16((MQUEU+6));
+    mAudioMemory16(NPOOL);
   #elif NBYTE==4
-    mAudioMemory32((MQUEU+6));
+    mAudioMemory32(NPOOL);
   #endif
+  bootMark(HDR_BOOT_MEMORY);
 
-  audioShield.enable();
-  audioShield.inputSelect(AUDIO_SELECT);  //AUDIO_INPUT_LINEIN or AUDIO_INPUT_MIC
+  #if (OUT_FORMAT==OUT_WAV) && (NBYTE==4) && (AUDIO_MODE==WMXZ)
+    acq.digitalShift(0); // WAV: 24 bit samples MSB aligned in 32 bit
+  #endif
+
+  int codecWarm = warmBoot && (RETAIN_CODEC>0);
+  if(codecWarm)
+  { Wire.begin();
+    SGTL5000_enable(); // was only powered down by stopAcq()
+  }
+  else
+  { audioShield.enable();
+    audioShield.inputSelect(AUDIO_SELECT);  //AUDIO_INPUT_LINEIN or AUDIO_INPUT_MIC
+  }
+  bootMark(HDR_BOOT_CODEC);
 
   //
   I2S_modification(fsamps[fr],32);
@@ -294,48 +364,87 @@ extern "C" void setup() {
   SGTL5000_modification(fr); // must be called after I2S initialization stabilized 
   //(0: 8kHz, 1: 16 kHz 2:32 kHz, 3:44.1 kHz, 4:48 kHz, 5:96 kHz, 6:192 kHz, 7:384kHz)
   
-  if(AUDIO_SELECT == AUDIO_INPUT_MIC)
+  if(AUDIO_SELECT == AUDIO_INPUT_MIC && !codecWarm)
   {
     audioShield.micGain(MicGain);
   }
+  bootMark(HDR_BOOT_I2S);
+
+  if(warmBoot)
+  { // continue in directory and with card parameters of last run
+    uSD.nFiles = retained.files;
+    if(retained.dirHour) uSD.resume(retained.dirHour);
+    if(retained.cardRate)
+    { uSD.cardRate = retained.cardRate;
+      uSD.writeChunk = retained.writeChunk;
+      uSD.cardMaxLatency = retained.cardMaxLatency;
+    }
+  }
 
-  uint32_t nsec = record_or_sleep();
+  sched.begin(r_hours, R_NPER, a_on, a_off, t_on);
+  int32_t nsec = record_or_sleep();
   if(nsec>0)
     stopAcq(nsec);
+  bootMark(HDR_BOOT_SCHED);
 
   uSD.init();
+  // card exchanged during hibernation: directory and write test of last run do not apply
+  uint8_t card = uSD.identify()? retainCard(uSD.cid): 0;
+  if(warmBoot && card != retained.card)
+  { uSD.resume(0);
+    uSD.cardRate = 0;
+  }
+  bootMark(HDR_BOOT_SD);
+  // a file holds at most t_on seconds of data plus header
+  uSD.setFileSize((uint64_t) t_on*fsamps[fr]*NCH*NBYTE + FILE_HDR_BYTES);
+  uSD.setFsamp(fsamps[fr]);
+  #if SD_CHECK>0
+    if(!uSD.cardRate) uSD.characterize(fsamps[fr]*NCH*NBYTE); // kept from last run on warm wake-up
+  #endif
+  bootMark(HDR_BOOT_SDTEST);
+
+  #if (DO_BENCH>0) && (AUDIO_MODE==WMXZ)
+    benchRun(); // uses the mounted card
+  #endif
   
   #if DO_DEBUG>0
+    Serial.printf("Memory (kB): DTCM %d of %d, OCRAM %d of %d, EXTMEM %d of %d\n",
+      memUsed(MEM_DTCM)/1024, MEM_SIZE_DTCM/1024, memUsed(MEM_OCRAM)/1024, MEM_SIZE_OCRAM/1024,
+      memUsed(MEM_EXTMEM)/1024, MEM_SIZE_EXTMEM/1024);
+    Serial.printf("Buffering: queue %d blocks (%d ms) + disk %d ms\n",
+      queueBlocks(), bufferingQueue(fsamps[fr]), bufferingDisk(fsamps[fr]));
     Serial.print("Fsamp "); Serial.println(fsamps[FSI]);
     Serial.println("start");
   #endif
 
+  rtcTrack();
   for(int ii=0; ii<NCH; ii++) queue[ii].begin();
-
+  bootMark(HDR_BOOT_START);
 }
 
-data_t tmpStore[NCH*128]; // temporary buffer
-
 void loop() {
   // put your main code here, to run repeatedly:
   static int16_t state=0; // 0: open new file, -1: last file
   static uint32_t tMax=0;
 
   static uint32_t t3=millis();
+  #if USE_GOVERNOR>0
+    uint32_t tLoop=micros();
+  #endif
+  int work=0; // loop was busy (for governor and wfi)
+  rtcTrack();
 
   if(state<0) return;
 
   int mustClose;
   int ret =doMenu();
-  if(ret>2) stopAcq(ret);
+  if(ret>2) { uSD.close(); stopAcq(ret); }
   if(ret<0) 
   { Serial.print(state); Serial.print(" "); Serial.print(do_acq); Serial.print(" "); Serial.println();
     do_acq=1; state=0; t3=millis(); startAcq();}
 
   mustClose = (do_acq==0);
   
-  data_t *data;
-
   uint32_t t1=millis();
 
   // check if we should continue to record, close file or hibernate
@@ -349,47 +458,74 @@ void loop() {
   }
   mustClose = !(nsec==0);
 
-  if(queue[NCH-1].available())
+  #if USE_WFI>0
+    // take blocks only when loopBatch() are queued (or file must be closed), then empty the queue
+    static int draining=0;
+    uint32_t nq = queue[NCH-1].available();
+    if(nq >= loopBatch() || mustClose) draining=1; else if(!nq) draining=0;
+    int haveData = draining && nq;
+  #else
+    int haveData = queue[NCH-1].available();
+  #endif
+
+  if(haveData)
   { // have data on queue
     t3=t1;
-    //
-    if(newHour()) uSD.chDir();
+    work=1;
+    int newBuffer = (outptr==diskBuffer);
+    if(!bootProf.t[HDR_BOOT_FIRST])
+    { // arrival of first block (others in queue arrived later), before its header is made
+      uint32_t t0 = micros() - (uint32_t) ((uint64_t) (queue[NCH-1].available()-1)*AUDIO_BLOCK_SAMPLES_NCH*1000000/fsamps[fr]);
+      bootProf.t[HDR_BOOT_FIRST] = t0? t0: 1;
+      #if DO_DEBUG>0
+        Serial.printf("wake-up to first block: %d.%03d ms (%s)\n", t0/1000, t0%1000, warmBoot? "warm": "cold");
+      #endif
+    }
     //
     if(state==0) //file needs to be opened
     { // generate header before file is opened
        uint32_t *header=(uint32_t *) headerUpdate();
-       uint32_t *ptr=(uint32_t *) outptr;
+       #if OUT_FORMAT==OUT_WAV
+         // WAV header with recorder header as chunk; sizes as expected, patched at close
+         wavFormat_t fmt = {fsamps[fr], NCH, NBYTE, ((hdr_t *) header)->format.validBits, 0};
+         wavHeader((uint8_t *) outptr, fmt, (uint64_t) t_on*fsamps[fr]*NCH*NBYTE, header, HDR_SIZE, FILE_HDR_BYTES);
+       #else
+         uint32_t *ptr=(uint32_t *) outptr;
        
-       // copy to disk buffer
-       for(int ii=0;ii<128;ii++) ptr[ii] = header[ii];
-       outptr+=256; //(512 bytes)
+         // copy to disk buffer
+         for(int ii=0;ii<HDR_SIZE/4;ii++) ptr[ii] = header[ii];
+       #endif
+       outptr+=FILE_HDR_BYTES/sizeof(data_t); //(keeps data sector aligned)
        state=1; // flag data ready for filing
     }
 
-    // fetch data from queue and multiplex channels
-    for(int ii=0; ii<NCH; ii++)
-    {
-      data = (data_t *)queue[ii].readBuffer(); 
-      //
-      // copy to temporary buffer
-      data_t *ptr= &tmpStore[ii];
-      for(int jj=0; jj<128; jj+=NCH) ptr[jj] = data[jj];
-      //
-      queue[ii].freeBuffer();
-    }
+    // fetch data from queue
+    data_t *data[NCH];
+    for(int ii=0; ii<NCH; ii++) data[ii] = (data_t *)queue[ii].readBuffer(); 
+
+    // capture time of this block: blocks behind it in queue arrived later
+    uint32_t tBlock = micros() - (uint32_t) ((uint64_t) (queue[NCH-1].available()+1)*AUDIO_BLOCK_SAMPLES_NCH*1000000/fsamps[fr]);
+    if(newBuffer) uSD.stamp(rtcAt(tBlock), tBlock);
+
+    #if MARK_DROPS>0
+      // blocks lost before this one: marker in front of block (always fits, see config.h)
+      uint32_t seq = queue[NCH-1].sequence();
+      if(seqValid && (seq != seqNext))
+      { markFill((markRecord_t *) outptr, seqNext, seq-seqNext, (seq-seqNext)*AUDIO_BLOCK_SAMPLES_NCH,
+          rtcAt(tBlock), tBlock);
+        outptr += sizeof(markRecord_t)/sizeof(data_t);
+        uSD.mark(sizeof(markRecord_t), newBuffer);
+      }
+      seqNext = seq+1;
+      seqValid = 1;
+    #endif
 
     //
-    int32_t ndat = 128;
-    if(outptr+NCH*128 > diskBuffer+BUFFERSIZE) ndat = (diskBuffer+BUFFERSIZE-outptr)/NCH;
-//    ndat=128;
+    int32_t ndat = AUDIO_BLOCK_SAMPLES_NCH;
+    if(outptr+NCH*AUDIO_BLOCK_SAMPLES_NCH > diskBuffer+BUFFERSIZE) ndat = (diskBuffer+BUFFERSIZE-outptr)/NCH;
  
-    //copy to disk buffer
-    data_t *ptr1=(int16_t *) outptr;
-    data_t *ptr2=(int16_t *) tmpStore;
-    for(int jj=0; jj<NCH*ndat; jj++) ptr1[jj] = ptr2[jj];
-    //
-    // advance buffer pointer
-    outptr += (NCH*ndat); // (NCH*ndat  words)
+    // multiplex channels directly into disk buffer
+    outptr = multiplex<NCH,data_t>(outptr, data, 0, ndat);
     //
     // 
     if(mustClose || (outptr == (diskBuffer+BUFFERSIZE)))
@@ -403,7 +539,9 @@ void loop() {
         }
       #endif
       if(outptr>diskBuffer)
-        state=uSD.write(diskBuffer,outptr-diskBuffer, mustClose); // this is blocking
+      { state=uSD.write(diskBuffer,outptr-diskBuffer, mustClose); // only queued for writing
+        diskBuffer=uSD.nextBuffer();
+      }
       //
       outptr = diskBuffer;
       if(mustClose) 
@@ -411,20 +549,21 @@ void loop() {
       }
     }
     //
-    if(ndat<128)
-    { // copy rest to disk buffer
-      data_t *ptr1=(data_t *) outptr;
-      data_t *ptr2=(data_t *) &tmpStore[NCH*ndat];
-      for(int jj=0; jj<NCH*(128-ndat); jj++) ptr1[jj] = ptr2[jj];
-      //
-      outptr += (NCH*(128-ndat));
+    if(ndat<AUDIO_BLOCK_SAMPLES_NCH)
+    { // multiplex rest of blocks into (flushed) disk buffer
+      uint32_t tRest = tBlock + (uint32_t) ((uint64_t) ndat*1000000/fsamps[fr]);
+      uSD.stamp(rtcAt(tRest), tRest);
+      outptr = multiplex<NCH,data_t>(outptr, data, ndat, AUDIO_BLOCK_SAMPLES_NCH);
     }
 
+    for(int ii=0; ii<NCH; ii++) queue[ii].freeBuffer();
+
     if((nsec>0) && (state==0) && (mustClose))  // if file is closed and acquisition ended
     { 
        #if DO_DEBUG>1
          Serial.print("mustClose "); Serial.println(state); 
        #endif
+      gov.boost(1);
       uSD.exit();
       state=-1;
       mustClose=0;
@@ -433,6 +572,8 @@ void loop() {
   }
   else
   { // no audio block usb_serial_available
+    // use idle time to close old file and to open next file
+    if(!mustClose) work = uSD.prepare();
     // should we close?
     if(state>0 && mustClose)
     {
@@ -440,14 +581,17 @@ void loop() {
        Serial.println("Closing B");
       #endif
       //but first write remaining data to disk
-      state=uSD.write(diskBuffer,outptr-diskBuffer, mustClose); // this is blocking
+      state=uSD.write(diskBuffer,outptr-diskBuffer, mustClose); // only queued for writing
+      diskBuffer=uSD.nextBuffer();
       outptr = diskBuffer;
       #if DO_DEBUG>1
         if(mustClose) { Serial.print("stateB = "); Serial.println(state);}
       #endif
       mustClose=0;
       if(nsec>0)
-      { stopAcq(nsec);
+      { gov.boost(1);
+        uSD.close(); // truncate last file, save its index, remove prepared next file
+        stopAcq(nsec);
       }
 
     }
@@ -461,10 +605,19 @@ void loop() {
       #endif
 
       uSD.close();
-      stopAcq(10);
+      stopAcq(10, 0); // cold start: set up codec again
       return;
     }
   }
+  // write pending disk buffers, if card is ready
+  if(uSD.npending()) work=1;
+  uSD.service();
+
+  #if USE_GOVERNOR>0
+    if(work) gov.busy(micros()-tLoop);
+    gov.update(queue[NCH-1].available(), queueBlocks()/4); // boost while queue backs up
+  #endif
+
   uint32_t t2=millis();
   if(t2-t1 > tMax) tMax=(t2-t1);
 
@@ -475,14 +628,18 @@ void loop() {
     static uint32_t t0=0;
     loopCount++;
     if(millis()>t0+1000)
-    {  Serial.printf("loop: %5d; %4d %4d %4d %6d %4d",
+    {  Serial.printf("loop: %5d; %4d %4d %4d %6d %4d %5d %d; %d MHz %d%%",
              loopCount,
-             mAudioMemoryUsageMax(), uSD.nCount, queue[0].dropCount, tMax, rtc_get() % t_on);
+             mAudioMemoryUsageMax(), uSD.nCount, queue[0].dropCount, tMax, rtc_get() % t_on,
+             uSD.nBusy, uSD.nPendMax, gov.clock()/1000000, gov.load);
+       if(gov.suggest && gov.suggest < F_CPU) Serial.printf(" (F_CPU %d MHz would do)", gov.suggest/1000000);
        Serial.println();
        //
        mAudioMemoryUsageMaxReset();
        //
        uSD.nCount=0;
+       uSD.nBusy=0;
+       uSD.nPendMax=0;
        loopCount=0;
        queue[0].dropCount=0;
        tMax=0;
@@ -491,6 +648,16 @@ void loop() {
     }
   #endif
 
-  //
-  //asm("wfi"); // to save some power switch off idle cpu
+  #if USE_WFI>0
+    // nothing to do: sleep until next interrupt (audio block, systick, USB)
+    if(!work && !draining && !uSD.npending() && !Serial.available()) waitForInterrupt();
+  #endif
 }
+
+#if defined(HOST_BUILD)
+// called by host main at end of simulation
+void host_shutdown(void)
+{
+  uSD.close();
+}
+#endif
@@ -0,0 +1,82 @@
+/* SGTL5000 Recorder for Teensy
+ * Copyright (c) 2018, Walter Zimmer
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice, development funding notice, and this permission
+ * notice shall be included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+/*
+ * drop marker: record written inline into the data stream of a .bin file
+ * wherever audio blocks were lost (queue full, or no free block for I2S)
+ *
+ * audio blocks carry a sequence number (I2S_32::update), loop() compares it
+ * with the expected one and inserts the record in front of the first block after the gap
+ * the record is 32 bytes, a whole number of frames, and as all header, block and
+ * marker sizes are multiples of 32 bytes it starts at a file offset divisible by 32
+ * readers scan these offsets for MARK_MAGIC and confirm with markValid()
+ * shared by recorder (main.cpp) and host reader (host/bin_index.h), little endian
+ */
+#ifndef _MARKER_FMT_H
+#define _MARKER_FMT_H
+
+#include <stdint.h>
+#include <string.h>
+
+#define MARK_MAGIC "WMRK"
+#define MARK_DROP  1
+
+typedef struct
+{ char magic[4];      // MARK_MAGIC
+  uint16_t type;      // MARK_DROP
+  uint16_t size;      // sizeof(markRecord_t)
+  uint32_t seq;       // sequence number of first lost block
+  uint32_t count;     // number of lost blocks
+  uint32_t frames;    // lost frames (count * samples per block and channel)
+  uint32_t rtc;       // RTC seconds at capture of block following gap
+  uint32_t usec;      // micros() at capture of block following gap
+  uint32_t check;     // ~(xor of preceding words)
+} markRecord_t;
+
+static_assert(sizeof(markRecord_t) == 32, "markRecord_t must be 32 bytes");
+
+static inline uint32_t markCheck(const markRecord_t *mr)
+{ const uint32_t *ww = (const uint32_t *) mr;
+  uint32_t cc = 0;
+  for(int ii=0; ii<7; ii++) cc ^= ww[ii];
+  return ~cc;
+}
+
+static inline void markFill(markRecord_t *mr, uint32_t seq, uint32_t count, uint32_t frames,
+                            uint32_t rtc, uint32_t usec)
+{ memcpy(mr->magic, MARK_MAGIC, 4);
+  mr->type = MARK_DROP;
+  mr->size = sizeof(markRecord_t);
+  mr->seq = seq;
+  mr->count = count;
+  mr->frames = frames;
+  mr->rtc = rtc;
+  mr->usec = usec;
+  mr->check = markCheck(mr);
+}
+
+static inline int markValid(const void *ptr)
+{ const markRecord_t *mr = (const markRecord_t *) ptr;
+  return !memcmp(mr->magic, MARK_MAGIC, 4) && mr->size == sizeof(markRecord_t) && mr->check == markCheck(mr);
+}
+
+#endif
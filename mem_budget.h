@@ -0,0 +1,49 @@
+/* SGTL5000 Recorder for Teensy
+ * Copyright (c) 2018, Walter Zimmer
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice, development funding notice, and this permission
+ * notice shall be included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+// compile-time memory budget per region (config.h: MEM_SIZE_*, *_MEM)
+// sizes are taken from the types the recorder allocates: audio pool and its block
+// descriptors (mAudioStream.h), queues (m_queue.h), seek index tables (index_fmt.h)
+#ifndef _MEM_BUDGET_H
+#define _MEM_BUDGET_H
+
+#include "config.h"
+#include "m_queue.h"
+#include "index_fmt.h"
+
+constexpr uint32_t memPool  = NPOOL*AUDIO_BLOCK_SAMPLES*NCH*NBYTE;
+constexpr uint32_t memDbuf  = NDBUF*BUFFERSIZE*NBYTE;
+constexpr uint32_t memI2S   = 2*AUDIO_BLOCK_SAMPLES*NCH*4;
+// always in RAM: queues, block descriptors of pool, the two index tables of c_uSD
+constexpr uint32_t memQueue = NCH*sizeof(mRecordQueue<MQUEU>) + NPOOL*sizeof(maudio_block_t)
+                            + 2*sizeof(idxTable_t<IDX_MAX>);
+
+constexpr uint32_t memUsed(int region)
+{ return ((POOL_MEM==region)? memPool: 0) + ((DBUF_MEM==region)? memDbuf: 0)
+       + ((I2S_MEM==region)? memI2S: 0) + ((MEM_DTCM==region)? memQueue: 0);
+}
+
+static_assert(memUsed(MEM_DTCM) <= MEM_SIZE_DTCM, "memory budget: DTCM (RAM) overflow, reduce MQUEU or BUFFERSIZE");
+static_assert(memUsed(MEM_OCRAM) <= MEM_SIZE_OCRAM, "memory budget: OCRAM (DMAMEM) overflow, reduce MQUEU or BUFFERSIZE");
+static_assert(memUsed(MEM_EXTMEM) <= MEM_SIZE_EXTMEM, "memory budget: EXTMEM overflow (PSRAM size, see MEM_SIZE_EXTMEM)");
+
+#endif
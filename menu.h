@@ -29,9 +29,11 @@
 #include "TimeLib.h"
 
 #include "config.h"
+#include "header_fmt.h"
 extern int do_acq;
 extern int gain;
 extern int fr;
+extern hdrBoot_t bootProf;
 
 int boundaryCheck(int val, int minVal, int maxVal)
 {
@@ -48,17 +50,32 @@ int boundaryCheck(int val, int minVal, int maxVal)
   return val; 
 }
 
+// duration of each phase of setup() since last reset or wake-up
+static void printBoot(void)
+{
+    static const char *names[] = HDR_BOOT_NAMES;
+    Serial.printf("boot (%s):", (bootProf.flags & HDR_BOOT_WARM)? "warm": "cold");
+    for(int ii=0; ii<HDR_BOOT_PHASES; ii++)
+    { uint32_t dt = bootProf.t[ii] - (ii? bootProf.t[ii-1]: 0);
+      if(ii==HDR_BOOT_FIRST && !bootProf.t[ii]) break;
+      Serial.printf(" %s %d.%03d", names[ii], dt/1000, dt%1000);
+    }
+    Serial.printf(" ms\r\n");
+}
+
 static void printAll(void)
 {
     Serial.printf("\n%02d-%02d-%04d %02d:%02d:%02d\n",day(),month(),year(), hour(),minute(),second());
     Serial.printf("g: shift  %d\n",gain);
     Serial.printf("f: fsamp  %d: %d Hz\n",fr, fsamps[fr]);
+    printBoot();
 
     Serial.println();
     Serial.println("enter    'a'    to print this");
     Serial.println();
-    Serial.println("exter    '?c'   to read value c=(g,f)");
+    Serial.println("exter    '?c'   to read value c=(g,f,b)");
     Serial.println("  e.g.:  '?g'   will print right shift");
+    Serial.println("         '?b'   will print boot profile (ms per phase of setup)");
     Serial.println();
     Serial.println("exter    '!cv'  to write value c=(g,f) and v is new value");
     Serial.println("  e.g.:  '!g8'  will set shift to 8 to  data>>8");
@@ -77,17 +94,18 @@ static void doMenu1(void) // ?
 {
     while(!Serial.available());
     char c=Serial.read();
-    if (strchr("gf", c))
+    if (strchr("gfb", c))
     { switch (c)
       {
         case 'g': Serial.printf("%d\r\n",gain); break;
         case 'f': Serial.printf("%d: %d\r\n",fr, fsamps[fr]); break;
+        case 'b': printBoot(); break;
       }
     }
 }
 
 static void doMenu2(void) // !
-{   while(!Serial.available());
+{   while(!Serial.available()) continue;
     char c=Serial.read();
     if (strchr("gf", c))
     { switch (c)
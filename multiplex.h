@@ -0,0 +1,50 @@
+/* SGTL5000 Recorder for Teensy
+ * Copyright (c) 2018, Walter Zimmer
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice, development funding notice, and this permission
+ * notice shall be included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#ifndef _MULTIPLEX_H
+#define _MULTIPLEX_H
+
+#include <stdint.h>
+
+/*
+ * interleave channel blocks directly into the disk buffer
+ *
+ * src[ii] points to the block of channel ii,
+ * samples j0 ... j1-1 of each channel are written as frames to out
+ * out must have room for nch*(j1-j0) words
+ * returns the advanced output pointer
+ *
+ * nch is a template parameter so that the compiler unrolls the inner loop
+ * for the usual 1/2/4/8 channel configurations
+ */
+template <int nch, typename T>
+static inline T * multiplex(T *out, T * const *src, int j0, int j1)
+{
+  for(int jj=j0; jj<j1; jj++)
+  {
+    for(int ii=0; ii<nch; ii++) out[ii] = src[ii][jj];
+    out += nch;
+  }
+  return out;
+}
+
+#endif
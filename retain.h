@@ -0,0 +1,137 @@
+/* SGTL5000 Recorder for Teensy
+ * Copyright (c) 2018, Walter Zimmer
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice, development funding notice, and this permission
+ * notice shall be included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+/*
+ * state retained across hibernation (fast warm resume)
+ *
+ * 16 bytes (four words) written before the recorder hibernates and read at wake-up:
+ * when valid, the wake-up is the expected alarm and the configuration did not change,
+ * setup() takes the fast path (no USB wait, no uSD write test, codec kept configured
+ * on Teensy 3.6) and continues in the directory and with the file count of the last run;
+ * directory and card parameters are kept only if the same uSD card (CID) is mounted
+ *
+ * storage survives hibernation, but not loss of power
+ *   K66: system register file (RFSYS, 32 bytes), kept in all VLLS modes incl. VLLS0
+ *   T4:  SNVS low power general purpose registers (LPGPR0..3)
+ *   host: file retain.bin in working directory (hal_host.h)
+ *
+ * word 0: RETAIN_MAGIC (8 bits), configuration hash (8), card fingerprint (8), check (8)
+ * word 1: RTC second of alarm
+ * word 2: hour of last directory since 1970 (20 bits), file counter (12)
+ * word 3: card rate kB/s (16), write chunk 512<<n (3), max card latency ms (8), spare (5)
+ */
+#ifndef _RETAIN_H
+#define _RETAIN_H
+
+#include <stdint.h>
+
+#define RETAIN_MAGIC 0xA7
+#define RETAIN_EARLY 2   // s, wake-up before alarm still accepted (RTC alarm resolution)
+#define RETAIN_LATE  60  // s, wake-up after alarm still accepted (boot, card mount)
+
+typedef struct
+{ uint32_t alarm;     // RTC second of expected wake-up
+  uint32_t dirHour;   // hour (since 1970) of last directory created, 0: none
+  uint32_t files;     // files written (modulo 4096)
+  uint32_t cardRate;  // bytes/s, 0: card not characterized
+  uint32_t writeChunk;
+  uint32_t cardMaxLatency; // us
+  uint8_t cfg;        // configuration hash (retainConfig)
+  uint8_t card;       // fingerprint of uSD card CID (retainCard), 0: unknown
+} retain_t;
+
+#if defined(__MK66FX1M0__)
+  #ifndef RFSYS_REG
+    #define RFSYS_REG(n) (*(volatile uint32_t *)(0x40041000 + 4*(n)))
+  #endif
+  static void retainWrite(const uint32_t *w) { for(int ii=0; ii<4; ii++) RFSYS_REG(ii) = w[ii]; }
+  static void retainRead(uint32_t *w) { for(int ii=0; ii<4; ii++) w[ii] = RFSYS_REG(ii); }
+
+#elif defined(__IMXRT1062__)
+  #ifndef SNVS_LPGPR_N
+    #define SNVS_LPGPR_N(n) (*(volatile uint32_t *)(0x400D4100 + 4*(n)))
+  #endif
+  static void retainWrite(const uint32_t *w) { for(int ii=0; ii<4; ii++) SNVS_LPGPR_N(ii) = w[ii]; }
+  static void retainRead(uint32_t *w) { for(int ii=0; ii<4; ii++) w[ii] = SNVS_LPGPR_N(ii); }
+
+#elif defined(HOST_BUILD)
+  static void retainWrite(const uint32_t *w) { hal_retain_store(w, 4); }
+  static void retainRead(uint32_t *w) { if(!hal_retain_load(w, 4)) w[0]=0; }
+#endif
+
+static inline uint8_t retainCheck(const uint32_t *w)
+{ uint32_t xx = w[1] ^ (w[2]*0x9E3779B1) ^ (w[3]*0x85EBCA77) ^ (w[0]>>8);
+  xx ^= xx>>16;
+  return (uint8_t) (xx ^ (xx>>8) ^ 0x5A);
+}
+
+// 8 bit FNV-1a fold of configuration words
+static inline uint8_t retainConfig(const uint32_t *cfg, int ncfg)
+{ uint32_t hh = 2166136261u;
+  for(int ii=0; ii<ncfg; ii++)
+    for(int jj=0; jj<32; jj+=8) { hh ^= (cfg[ii]>>jj) & 0xff; hh *= 16777619u; }
+  return (uint8_t) (hh ^ (hh>>8) ^ (hh>>16) ^ (hh>>24));
+}
+
+// 8 bit fingerprint of CID register (16 bytes), never 0
+static inline uint8_t retainCard(const uint8_t *cid)
+{ uint32_t ww[4];
+  for(int ii=0; ii<4; ii++)
+    ww[ii] = ((uint32_t) cid[4*ii]<<24) | ((uint32_t) cid[4*ii+1]<<16) | ((uint32_t) cid[4*ii+2]<<8) | cid[4*ii+3];
+  uint8_t hh = retainConfig(ww, 4);
+  return hh? hh: 1;
+}
+
+static void retainSave(const retain_t &rs)
+{ uint32_t w[4];
+  uint32_t chunk = 0;
+  while(chunk<7 && (512u<<chunk) < rs.writeChunk) chunk++;
+  uint32_t lat = (rs.cardMaxLatency+999)/1000;
+  uint32_t rate = rs.cardRate/1024;
+  w[0] = (RETAIN_MAGIC<<24) | ((uint32_t) rs.cfg<<16) | ((uint32_t) rs.card<<8);
+  w[1] = rs.alarm;
+  w[2] = (rs.dirHour<<12) | (rs.files & 0xfff);
+  w[3] = ((rate>0xffff? 0xffff: rate)<<16) | (chunk<<13) | ((lat>0xff? 0xff: lat)<<5);
+  w[0] |= retainCheck(w);
+  retainWrite(w);
+}
+
+// 1: valid state was retained
+static int retainLoad(retain_t &rs)
+{ uint32_t w[4];
+  retainRead(w);
+  if((w[0]>>24) != RETAIN_MAGIC || (w[0] & 0xff) != retainCheck(w)) return 0;
+  rs.cfg = (w[0]>>16) & 0xff;
+  rs.card = (w[0]>>8) & 0xff;
+  rs.alarm = w[1];
+  rs.dirHour = w[2]>>12;
+  rs.files = w[2] & 0xfff;
+  rs.cardRate = (w[3]>>16)*1024;
+  rs.writeChunk = 512u << ((w[3]>>13) & 7);
+  rs.cardMaxLatency = ((w[3]>>5) & 0xff)*1000;
+  return 1;
+}
+
+// invalidate (next boot is cold)
+static void retainClear(void) { uint32_t w[4] = {0, 0, 0, 0}; retainWrite(w); }
+
+#endif
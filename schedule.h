@@ -0,0 +1,177 @@
+/* SGTL5000 Recorder for Teensy
+ * Copyright (c) 2018, Walter Zimmer
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice, development funding notice, and this permission
+ * notice shall be included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+/*
+ * recording schedule: daily periods, duty cycle (a_on, a_off) and file length (t_on)
+ *
+ * begin() compiles the daily periods into a sorted table of transitions (seconds of
+ * day, state from there on). check() is called from loop(): it compares against a
+ * cached deadline (next file boundary or end of recording) and only past it looks
+ * into the table, so the usual call costs one comparison.
+ * no Arduino dependencies: shared by recorder (main.cpp) and host tools
+ *
+ * periods: {start, end} in seconds of day, end smaller than start runs over midnight,
+ * start==end is empty; overlapping and adjacent periods merge; no period: whole day
+ * duty cycle: recording while (t % (a_on+a_off)) < a_on (a_off 0: always)
+ * files: new file at every multiple of t_on (seconds since 1970)
+ */
+#ifndef _SCHEDULE_H
+#define _SCHEDULE_H
+
+#include <stdint.h>
+
+#define SCHED_MAX_PERIODS 8
+#define SCHED_DAY (24*3600)
+
+typedef struct
+{ uint32_t start, end; // seconds of day
+} schedPeriod_t;
+
+class c_schedule
+{
+  public:
+    void begin(const schedPeriod_t *per, int nper, uint32_t a_on, uint32_t a_off, uint32_t t_on)
+    { aOn = a_on; aOff = a_off; tOn = t_on? t_on: 1;
+      if(nper > SCHED_MAX_PERIODS) nper = SCHED_MAX_PERIODS;
+
+      // all period bounds, sorted and unique
+      nedge = 0;
+      for(int ii=0; ii<nper; ii++)
+      { if(per[ii].start == per[ii].end) continue;
+        addEdge(per[ii].start % SCHED_DAY);
+        addEdge(per[ii].end % SCHED_DAY);
+      }
+      allDay = (nedge == 0);
+      for(int ii=1; ii<nedge; ii++)
+        for(int jj=ii; jj>0 && edge[jj-1] > edge[jj]; jj--)
+        { uint32_t tmp = edge[jj]; edge[jj] = edge[jj-1]; edge[jj-1] = tmp; }
+
+      // state behind each bound, keep only changes
+      int nn = 0;
+      for(int ii=0; ii<nedge; ii++)
+      { uint8_t st = 0;
+        for(int kk=0; kk<nper; kk++) st |= inPeriod(per[kk], edge[ii]);
+        if(nn && on[nn-1] == st) continue;
+        edge[nn] = edge[ii]; on[nn] = st; nn++;
+      }
+      if(nn > 1 && on[nn-1] == on[0]) // no change at first bound (same state across midnight)
+      { for(int ii=1; ii<nn; ii++) { edge[ii-1] = edge[ii]; on[ii-1] = on[ii]; }
+        nn--;
+      }
+      nedge = nn;
+      if(nedge == 1) { allDay = on[0]; nedge = on[0]? 0: 1; } // never changes
+      reset();
+    }
+
+    // periods in hours as in config.h (r_hours)
+    void begin(const uint16_t hours[][2], int nper, uint32_t a_on, uint32_t a_off, uint32_t t_on)
+    { schedPeriod_t per[SCHED_MAX_PERIODS];
+      if(nper > SCHED_MAX_PERIODS) nper = SCHED_MAX_PERIODS;
+      for(int ii=0; ii<nper; ii++) { per[ii].start = hours[ii][0]*3600u; per[ii].end = hours[ii][1]*3600u; }
+      begin(per, nper, a_on, a_off, t_on);
+    }
+
+    // forget deadline and file boundary (e.g. after hibernation or stop)
+    void reset(void) { deadline = 0; fileEnd = 0; }
+
+    // 0: keep recording, -1: close file and open next, >0: seconds to sleep
+    int32_t check(uint32_t tt)
+    { if(tt < deadline) return 0;
+      if(!recording(tt))
+      { reset();
+        uint32_t ton = nextOn(tt);
+        return (ton > tt)? (int32_t) (ton - tt): 1;
+      }
+      int32_t ret = (fileEnd && tt >= fileEnd)? -1: 0;
+      fileEnd = (tt/tOn + 1)*tOn;
+      uint32_t toff = nextOff(tt);
+      deadline = (fileEnd < toff)? fileEnd: toff;
+      return ret;
+    }
+
+    // time when check() has to look again (0: at next call)
+    uint32_t next(void) const { return deadline; }
+
+    bool inWindow(uint32_t tt) const
+    { if(!nedge) return allDay;
+      return on[slot(tt % SCHED_DAY)];
+    }
+
+    bool inDuty(uint32_t tt) const { return !aOff || (tt % (aOn + aOff)) < aOn; }
+
+    bool recording(uint32_t tt) const { return inWindow(tt) && inDuty(tt); }
+
+    // first time >= tt with recording (tt itself if recording); gives up after 64 steps
+    uint32_t nextOn(uint32_t tt) const
+    { for(int ii=0; ii<64; ii++)
+      { if(!inWindow(tt)) tt = nextEdge(tt, 1);
+        else if(!inDuty(tt)) tt = tt - tt % (aOn + aOff) + aOn + aOff;
+        else break;
+      }
+      return tt;
+    }
+
+    // first time > tt without recording (0xffffffff: never)
+    uint32_t nextOff(uint32_t tt) const
+    { uint32_t tw = nedge? nextEdge(tt, 0): 0xffffffff;
+      uint32_t td = aOff? tt - tt % (aOn + aOff) + aOn: 0xffffffff;
+      if(td <= tt) td += aOn + aOff;
+      return (tw < td)? tw: td;
+    }
+
+  private:
+    uint32_t edge[2*SCHED_MAX_PERIODS]; // transitions, seconds of day, ascending
+    uint8_t on[2*SCHED_MAX_PERIODS];    // in window from edge[ii] up to edge[ii+1]
+    int nedge;
+    bool allDay;                        // no transition: always (or never) in window
+    uint32_t aOn, aOff, tOn;
+    uint32_t deadline, fileEnd;
+
+    void addEdge(uint32_t tod)
+    { for(int ii=0; ii<nedge; ii++) if(edge[ii] == tod) return;
+      edge[nedge++] = tod;
+    }
+
+    static uint8_t inPeriod(const schedPeriod_t &pp, uint32_t tod)
+    { uint32_t ss = pp.start % SCHED_DAY, ee = pp.end % SCHED_DAY;
+      if(pp.start == pp.end) return 0;
+      if(ss == ee) return 1; // e.g. 0..24 h
+      return (ss < ee)? (tod >= ss && tod < ee): (tod >= ss || tod < ee);
+    }
+
+    // transition in effect at time of day (last one before midnight if none yet)
+    int slot(uint32_t tod) const
+    { int ii = nedge-1;
+      while(ii >= 0 && edge[ii] > tod) ii--;
+      return (ii < 0)? nedge-1: ii;
+    }
+
+    // first time > tt where window state becomes st
+    uint32_t nextEdge(uint32_t tt, uint8_t st) const
+    { uint32_t day = tt - tt % SCHED_DAY, tod = tt % SCHED_DAY;
+      for(int dd=0; dd<2; dd++, day += SCHED_DAY)
+        for(int ii=0; ii<nedge; ii++)
+          if(on[ii] == st && (dd || edge[ii] > tod)) return day + edge[ii];
+      return tt + SCHED_DAY;
+    }
+};
+
+#endif
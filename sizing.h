@@ -0,0 +1,38 @@
+// generated by host/bin/sizing, do not edit
+// model: base 2000 us, rate 20 B/us, stall 250000 us with p=16/65536
+// NDBUF 3, chunk 4096, 600 s per case, margin 25%
+#ifndef SIZING_H
+#define SIZING_H
+
+#define SIZING_NFS 8
+
+constexpr uint32_t sizingFsamp[SIZING_NFS] = {8000, 16000, 32000, 44100, 48000, 96000, 192000, 384000};
+
+#if NCH==1 && NBYTE==2
+  constexpr uint32_t sizingMQUEU[SIZING_NFS] = {3, 3, 20, 49, 59, 178, 414, 887};
+  constexpr uint32_t sizingNPOOL[SIZING_NFS] = {9, 9, 26, 55, 65, 184, 420, 893};
+  constexpr uint32_t sizingBUFFERSIZE[SIZING_NFS] = {2048, 2048, 2048, 2048, 2048, 2048, 2048, 2048};
+#elif NCH==1 && NBYTE==4
+  constexpr uint32_t sizingMQUEU[SIZING_NFS] = {3, 3, 40, 69, 79, 198, 434, 1785};
+  constexpr uint32_t sizingNPOOL[SIZING_NFS] = {9, 9, 46, 75, 85, 204, 440, 1791};
+  constexpr uint32_t sizingBUFFERSIZE[SIZING_NFS] = {2048, 2048, 2048, 2048, 2048, 2048, 2048, 2048};
+#elif NCH==2 && NBYTE==2
+  constexpr uint32_t sizingMQUEU[SIZING_NFS] = {3, 5, 25, 40, 45, 104, 223, 899};
+  constexpr uint32_t sizingNPOOL[SIZING_NFS] = {12, 16, 56, 86, 96, 214, 452, 1804};
+  constexpr uint32_t sizingBUFFERSIZE[SIZING_NFS] = {2048, 2048, 2048, 2048, 2048, 2048, 2048, 2048};
+#elif NCH==2 && NBYTE==4
+  constexpr uint32_t sizingMQUEU[SIZING_NFS] = {3, 10, 30, 45, 50, 109, 447, 0};
+  constexpr uint32_t sizingNPOOL[SIZING_NFS] = {12, 26, 66, 96, 106, 224, 900, 0};
+  constexpr uint32_t sizingBUFFERSIZE[SIZING_NFS] = {2048, 2048, 2048, 2048, 2048, 2048, 2048, 2048};
+#else
+  #error "sizing.h: no sizes for this NCH/NBYTE (make -C host sizing)"
+#endif
+
+// MQUEU 0: card does not keep up at this rate
+constexpr bool sizingValid(int ii)
+{ return ii<0 || ((!sizingMQUEU[ii] || (sizingMQUEU[ii] >= 2 && sizingNPOOL[ii] >= NCH*sizingMQUEU[ii]))
+    && (sizingBUFFERSIZE[ii]*NBYTE) % 512 == 0 && sizingValid(ii-1));
+}
+static_assert(sizingValid(SIZING_NFS-1), "sizing.h: invalid queue or buffer size");
+
+#endif
@@ -0,0 +1,145 @@
+/* SGTL5000 Recorder for Teensy
+ * Copyright (c) 2018, Walter Zimmer
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice, development funding notice, and this permission
+ * notice shall be included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+/*
+ * WAV / RF64 header (EBU Tech 3306), little endian
+ *
+ *   RIFF|RF64 <size> WAVE
+ *   ds64|JUNK (28)        64 bit sizes; JUNK while the file fits in 4 GB
+ *   fmt  (40)             WAVE_FORMAT_EXTENSIBLE (container and valid bits)
+ *   wmxz (n)              optional: recorder header (header_fmt.h)
+ *   JUNK (n)              optional: padding so that data starts at requested offset
+ *   data <size>
+ *
+ * samples are stored as recorded (LSB aligned); with validBits < container bits
+ * readers expect MSB aligned samples, so producers shift left (see host/bin2wav.cpp)
+ * shared by host converter and recorder (WAV output mode)
+ */
+#ifndef _WAV_FMT_H
+#define _WAV_FMT_H
+
+#include <stdint.h>
+#include <string.h>
+
+#define WAV_MIN_HEADER (12 + 36 + 48 + 8) // RIFF, ds64, fmt, data
+
+typedef struct
+{ uint32_t fsamp;
+  uint16_t nch;
+  uint16_t nbyte;       // container bytes per sample
+  uint16_t validBits;
+  uint32_t chanMask;    // speaker positions (0: none)
+} wavFormat_t;
+
+static inline uint8_t *wavPut32(uint8_t *pp, uint32_t val) { memcpy(pp, &val, 4); return pp+4; }
+static inline uint8_t *wavPut16(uint8_t *pp, uint16_t val) { memcpy(pp, &val, 2); return pp+2; }
+static inline uint8_t *wavPut64(uint8_t *pp, uint64_t val) { memcpy(pp, &val, 8); return pp+8; }
+static inline uint8_t *wavTag(uint8_t *pp, const char *tag, uint32_t size) { memcpy(pp, tag, 4); return wavPut32(pp+4, size); }
+
+/*
+ * build header for dataBytes of samples into buf, returns header size
+ * hdrBytes: 0 for minimal header, else data starts at hdrBytes (even, >= minimal + 8)
+ * meta: optional chunk 'wmxz' of metaBytes (even)
+ * becomes RF64 if the file exceeds 4 GB; calling again with the final size patches the header
+ */
+static inline uint32_t wavHeader(uint8_t *buf, const wavFormat_t &fmt, uint64_t dataBytes,
+                                 const void *meta, uint32_t metaBytes, uint32_t hdrBytes)
+{
+  uint32_t need = WAV_MIN_HEADER + (meta? 8 + metaBytes: 0);
+  if(!hdrBytes) hdrBytes = need;
+  if(hdrBytes != need && hdrBytes < need + 8) return 0;
+
+  uint64_t riffBytes = hdrBytes - 8 + dataBytes;
+  int rf64 = (riffBytes > 0xffffffffull);
+  uint32_t frameBytes = fmt.nch*fmt.nbyte;
+
+  uint8_t *pp = buf;
+  pp = wavTag(pp, rf64? "RF64": "RIFF", rf64? 0xffffffff: (uint32_t) riffBytes);
+  memcpy(pp, "WAVE", 4); pp += 4;
+
+  pp = wavTag(pp, rf64? "ds64": "JUNK", 28);
+  pp = wavPut64(pp, rf64? riffBytes: 0);
+  pp = wavPut64(pp, rf64? dataBytes: 0);
+  pp = wavPut64(pp, rf64? dataBytes/frameBytes: 0);
+  pp = wavPut32(pp, 0); // no table
+
+  pp = wavTag(pp, "fmt ", 40);
+  pp = wavPut16(pp, 0xfffe); // WAVE_FORMAT_EXTENSIBLE
+  pp = wavPut16(pp, fmt.nch);
+  pp = wavPut32(pp, fmt.fsamp);
+  pp = wavPut32(pp, fmt.fsamp*frameBytes);
+  pp = wavPut16(pp, frameBytes);
+  pp = wavPut16(pp, 8*fmt.nbyte);
+  pp = wavPut16(pp, 22);
+  pp = wavPut16(pp, fmt.validBits);
+  pp = wavPut32(pp, fmt.chanMask);
+  static const uint8_t pcmGuid[16] =
+    {0x01,0x00,0x00,0x00, 0x00,0x00,0x10,0x00, 0x80,0x00,0x00,0xaa,0x00,0x38,0x9b,0x71};
+  memcpy(pp, pcmGuid, 16); pp += 16;
+
+  if(meta)
+  { pp = wavTag(pp, "wmxz", metaBytes);
+    memcpy(pp, meta, metaBytes); pp += metaBytes;
+  }
+  if(hdrBytes > need)
+  { uint32_t pad = hdrBytes - need - 8;
+    pp = wavTag(pp, "JUNK", pad);
+    memset(pp, 0, pad); pp += pad;
+  }
+  pp = wavTag(pp, "data", rf64? 0xffffffff: (uint32_t) dataBytes);
+  return pp - buf;
+}
+
+/*
+ * patch sizes of header in buf (as built by wavHeader, nbuf bytes up to and including
+ * data chunk header) for a file of fileBytes; returns 0 if buf is no such header
+ */
+static inline int wavPatch(uint8_t *buf, uint32_t nbuf, uint64_t fileBytes)
+{
+  if(nbuf < WAV_MIN_HEADER || (memcmp(buf, "RIFF", 4) && memcmp(buf, "RF64", 4)) || memcmp(buf+8, "WAVE", 4)
+      || (memcmp(buf+12, "ds64", 4) && memcmp(buf+12, "JUNK", 4)) || memcmp(buf+48, "fmt ", 4))
+    return 0;
+  uint16_t frameBytes;
+  memcpy(&frameBytes, buf+48+8+12, 2);
+
+  uint32_t pos = 12;
+  while(pos+8 <= nbuf && memcmp(buf+pos, "data", 4))
+  { uint32_t size;
+    memcpy(&size, buf+pos+4, 4);
+    pos += 8 + size + (size & 1);
+  }
+  if(pos+8 > nbuf || !frameBytes || fileBytes < pos+8) return 0;
+
+  uint64_t dataBytes = fileBytes - (pos+8);
+  uint64_t riffBytes = fileBytes - 8;
+  int rf64 = (riffBytes > 0xffffffffull);
+  memcpy(buf, rf64? "RF64": "RIFF", 4);
+  wavPut32(buf+4, rf64? 0xffffffff: (uint32_t) riffBytes);
+  uint8_t *pp = wavTag(buf+12, rf64? "ds64": "JUNK", 28);
+  pp = wavPut64(pp, rf64? riffBytes: 0);
+  pp = wavPut64(pp, rf64? dataBytes: 0);
+  wavPut64(pp, rf64? dataBytes/frameBytes: 0);
+  wavPut32(buf+pos+4, rf64? 0xffffffff: (uint32_t) dataBytes);
+  return 1;
+}
+
+#endif